@@ -1 +1,2 @@
-g++ -O3 -Wno-unused-result -o Transformation src/main.cpp -lGL -lGLEW -lglfw -lm
+g++ -O3 -Wno-unused-result "$@" -o Transformation src/main.cpp -lGL -lGLEW -lglfw -lEGL -lm -lpthread
+g++ -O3 -Wno-unused-result "$@" -o Benchmark src/bench.cpp -lm -lpthread
@@ -0,0 +1,4 @@
+mkdir -p timings
+for mesh in off/*.off; do
+    ./Transformation --headless --mesh "$mesh" --timings "timings/$(basename "$mesh" .off).csv" "$@"
+done
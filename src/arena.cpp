@@ -0,0 +1,76 @@
+#if !defined(HEADER_ARENA_CPP)
+#define HEADER_ARENA_CPP
+
+#define ARENA_ALIGN   16
+#define ARENA_COMMIT  (64 * 1024)
+
+static size_t arena_round(size_t size, size_t align) {
+    return (size + align - 1) & ~(align - 1);
+}
+
+static void arena_free(Arena *arena) {
+    if (arena->base)
+        munmap(arena->base, arena->capacity);
+
+    arena->base = 0;
+    arena->used = 0;
+    arena->committed = 0;
+    arena->capacity = 0;
+}
+
+// Empties the arena and makes sure it can hold at least capacity bytes. The
+// range is only reserved as inaccessible address space; arena_push commits
+// pages as it grows into them, so memory use follows what is actually used.
+static void arena_reserve(Arena *arena, size_t capacity) {
+    capacity = arena_round(capacity ? capacity : 1, ARENA_COMMIT);
+    arena->used = 0;
+
+    if (arena->base && arena->capacity >= capacity)
+        return;
+
+    arena_free(arena);
+
+    void *base = mmap(0, capacity, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE, -1, 0);
+
+    if (base == MAP_FAILED) {
+        fprintf(stderr, "ERROR: Arena reservation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    arena->base = (char *)base;
+    arena->capacity = capacity;
+}
+
+// Returns 0 once the reservation is exhausted, so a reader can reject input
+// that outgrew the size it was reserved for.
+static void *arena_push(Arena *arena, size_t size) {
+    size = arena_round(size, ARENA_ALIGN);
+
+    if (!arena->base || arena->used + size > arena->capacity) {
+        fprintf(stderr, "ERROR: Arena out of memory!\n");
+        return 0;
+    }
+
+    if (arena->used + size > arena->committed) {
+        size_t committed = arena_round(arena->used + size, ARENA_COMMIT);
+        if (committed > arena->capacity)
+            committed = arena->capacity;
+
+        if (mprotect(arena->base + arena->committed, committed - arena->committed, PROT_READ | PROT_WRITE)) {
+            fprintf(stderr, "ERROR: Arena commit failed!\n");
+            return 0;
+        }
+
+        arena->committed = committed;
+    }
+
+    void *result = arena->base + arena->used;
+    arena->used += size;
+    return result;
+}
+
+static void arena_reset(Arena *arena) {
+    arena->used = 0;
+}
+
+#endif
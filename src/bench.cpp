@@ -0,0 +1,341 @@
+#include "common.h"
+#include "timer.cpp"
+#include "profile.cpp"
+#include "arena.cpp"
+#include "read.cpp"
+#include "transform.cpp"
+
+#include <dirent.h>
+
+#define BENCH_WARMUP  5
+#define BENCH_SAMPLES 50
+#define BENCH_BATCH   10000
+#define BENCH_INPUTS  256
+#define MAX_FILES     1024
+#define MAX_BENCH     (32 + 3 * MAX_FILES)
+
+typedef void (*Bench_Func)(void *data, int iteration);
+
+typedef struct {
+    const char *name;
+    const char *method;
+    const char *file;
+    const char *unit;
+    int samples, batch;
+    double min, mean, stddev;
+    double p50, p90, p99;
+} Bench_Result;
+
+typedef struct {
+    Bench_Result results[MAX_BENCH];
+    int count;
+
+    int warmup, samples;
+    const char *json_path;
+    const char *corpus;
+    int max_files;
+} Bench;
+
+typedef struct {
+    M4x4 m[BENCH_INPUTS];
+    glm::vec3 pos[BENCH_INPUTS];
+    glm::vec3 dir[BENCH_INPUTS];
+    glm::vec4 plane[BENCH_INPUTS];
+    float value[BENCH_INPUTS];
+    Transform_Method method;
+} Bench_Inputs;
+
+typedef struct {
+    char *path[MAX_FILES];
+    int count;
+    int current;
+    Mesh mesh;
+    Arena arena;
+} Bench_Files;
+
+static volatile float bench_sink;
+
+static float random_float(float min, float max) {
+    return min + (max - min) * (rand() / (float)RAND_MAX);
+}
+
+static int compare_double(const void *a, const void *b) {
+    double da = *(const double *)a;
+    double db = *(const double *)b;
+    return (da > db) - (da < db);
+}
+
+static int compare_str(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+static double percentile(double *sorted, int count, double p) {
+    int index = (int)ceil(p * count) - 1;
+    if (index < 0)      index = 0;
+    if (index >= count) index = count - 1;
+    return sorted[index];
+}
+
+static void run_bench(Bench *bench, const char *name, const char *method, const char *file,
+                      Bench_Func func, void *data, int batch, int samples) {
+    double *times = (double *)malloc(samples * sizeof(double));
+    int iteration = 0;
+
+    for (int i = 0; i < bench->warmup; i++) {
+        for (int j = 0; j < batch; j++)
+            func(data, iteration++);
+    }
+
+    for (int i = 0; i < samples; i++) {
+        double tstart = get_time();
+        for (int j = 0; j < batch; j++)
+            func(data, iteration++);
+        times[i] = (get_time() - tstart) / batch;
+    }
+
+    qsort(times, samples, sizeof(double), compare_double);
+
+    double scale = batch > 1 ? 1000000000.0 : 1000.0;
+    double total = 0.0, total2 = 0.0;
+
+    for (int i = 0; i < samples; i++) {
+        times[i] *= scale;
+        total += times[i];
+        total2 += times[i] * times[i];
+    }
+
+    Bench_Result *result = &bench->results[bench->count++];
+    result->name = name;
+    result->method = method;
+    result->file = file;
+    result->unit = batch > 1 ? "ns" : "ms";
+    result->samples = samples;
+    result->batch = batch;
+    result->min = times[0];
+    result->mean = total / samples;
+    result->stddev = sqrt(fmax(total2 / samples - result->mean * result->mean, 0.0));
+    result->p50 = percentile(times, samples, 0.50);
+    result->p90 = percentile(times, samples, 0.90);
+    result->p99 = percentile(times, samples, 0.99);
+
+    fprintf(stdout, "%-16s %-7s %-24s min %10.3f%s  mean %10.3f%s  sd %8.3f  p50 %10.3f  p90 %10.3f  p99 %10.3f\n",
+            name, method, file, result->min, result->unit, result->mean, result->unit, result->stddev,
+            result->p50, result->p90, result->p99);
+
+    free(times);
+}
+
+static void bench_multiply(void *data, int i) {
+    Bench_Inputs *in = (Bench_Inputs *)data;
+    M4x4 r = in->m[i % BENCH_INPUTS] * in->m[(i + 1) % BENCH_INPUTS];
+    bench_sink += r.e[3][3];
+}
+
+static void bench_transpose(void *data, int i) {
+    Bench_Inputs *in = (Bench_Inputs *)data;
+    M4x4 r = m4x4_transpose(in->m[i % BENCH_INPUTS]);
+    bench_sink += r.e[0][3];
+}
+
+static void bench_rotation(void *data, int i) {
+    Bench_Inputs *in = (Bench_Inputs *)data;
+    int k = i % BENCH_INPUTS;
+    M4x4 r = rotation(in->method, in->pos[k], in->dir[k], in->value[k]);
+    bench_sink += r.e[0][3];
+}
+
+static void bench_scale(void *data, int i) {
+    Bench_Inputs *in = (Bench_Inputs *)data;
+    int k = i % BENCH_INPUTS;
+    M4x4 r = scale(in->method, in->pos[k], in->dir[k]);
+    bench_sink += r.e[0][3];
+}
+
+static void bench_reflection(void *data, int i) {
+    Bench_Inputs *in = (Bench_Inputs *)data;
+    M4x4 r = reflection(in->method, in->plane[i % BENCH_INPUTS]);
+    bench_sink += r.e[0][3];
+}
+
+static void bench_shear(void *data, int i) {
+    Bench_Inputs *in = (Bench_Inputs *)data;
+    int k = i % BENCH_INPUTS;
+    M4x4 r = shear(in->method, "xyz"[k % 3], in->value[k]);
+    bench_sink += r.e[1][0];
+}
+
+static void bench_translate(void *data, int i) {
+    Bench_Inputs *in = (Bench_Inputs *)data;
+    M4x4 r = translate(in->method, in->pos[i % BENCH_INPUTS]);
+    bench_sink += r.e[0][3];
+}
+
+static void bench_read_txt(void *data, int i) {
+    Bench_Files *files = (Bench_Files *)data;
+    Transform_Op *ops;
+    int count;
+
+    arena_reset(&files->arena);
+    if (!read_txt(files->path[files->current], &files->arena, &ops, &count))
+        exit(EXIT_FAILURE);
+
+    bench_sink += count;
+}
+
+static void bench_read_off(void *data, int i) {
+    Bench_Files *files = (Bench_Files *)data;
+    Mesh *mesh = &files->mesh;
+
+    free(mesh->index);
+    free(mesh->vertex);
+    *mesh = {};
+
+    if (!read_off(files->path[files->current], mesh))
+        exit(EXIT_FAILURE);
+
+    bench_sink += mesh->num_faces;
+}
+
+static void bench_normals(void *data, int i) {
+    Bench_Files *files = (Bench_Files *)data;
+    compute_normals(&files->mesh);
+    bench_sink += files->mesh.vertex[0].n.x;
+}
+
+static void list_files(Bench_Files *files, const char *dir, const char *ext, int max_files) {
+    DIR *d = opendir(dir);
+
+    if (!d) {
+        fprintf(stderr, "ERROR: Could not open directory %s!\n", dir);
+        exit(EXIT_FAILURE);
+    }
+
+    struct dirent *entry;
+    while ((entry = readdir(d)) && files->count < MAX_FILES) {
+        const char *name = entry->d_name;
+        size_t len = strlen(name);
+        size_t ext_len = strlen(ext);
+
+        if (len <= ext_len || strcmp(name + len - ext_len, ext))
+            continue;
+
+        char *path = (char *)malloc(strlen(dir) + len + 2);
+        sprintf(path, "%s/%s", dir, name);
+        files->path[files->count++] = path;
+    }
+
+    closedir(d);
+    qsort(files->path, files->count, sizeof(char *), compare_str);
+
+    if (max_files > 0 && files->count > max_files)
+        files->count = max_files;
+}
+
+static void write_json(Bench *bench) {
+    FILE *fptr = fopen(bench->json_path, "w");
+
+    if (!fptr) {
+        fprintf(stderr, "ERROR: %s file failed to open!\n", bench->json_path);
+        exit(EXIT_FAILURE);
+    }
+
+    fprintf(fptr, "{\n  \"benchmarks\": [\n");
+
+    for (int i = 0; i < bench->count; i++) {
+        Bench_Result *r = &bench->results[i];
+        fprintf(fptr, "    {\"name\": \"%s\", \"method\": \"%s\", \"file\": \"%s\", \"unit\": \"%s\", \"samples\": %d, \"batch\": %d, "
+                      "\"min\": %f, \"mean\": %f, \"stddev\": %f, \"p50\": %f, \"p90\": %f, \"p99\": %f}%s\n",
+                r->name, r->method, r->file, r->unit, r->samples, r->batch,
+                r->min, r->mean, r->stddev, r->p50, r->p90, r->p99, i + 1 < bench->count ? "," : "");
+    }
+
+    fprintf(fptr, "  ]\n}\n");
+    fclose(fptr);
+}
+
+static void parse_bench_options(Bench *bench, int argc, char **argv) {
+    bench->warmup = BENCH_WARMUP;
+    bench->samples = BENCH_SAMPLES;
+    bench->corpus = "off";
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--json") && i + 1 < argc) {
+            bench->json_path = argv[++i];
+        } else if (!strcmp(argv[i], "--samples") && i + 1 < argc) {
+            bench->samples = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--warmup") && i + 1 < argc) {
+            bench->warmup = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--corpus") && i + 1 < argc) {
+            bench->corpus = argv[++i];
+        } else if (!strcmp(argv[i], "--files") && i + 1 < argc) {
+            bench->max_files = atoi(argv[++i]);
+        } else {
+            fprintf(stderr, "ERROR: Unknown option %s!\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+
+    if (bench->samples < 1)
+        bench->samples = 1;
+}
+
+int main(int argc, char **argv) {
+    static Bench bench = {};
+    parse_bench_options(&bench, argc, argv);
+
+    static Bench_Inputs inputs = {};
+    srand(1);
+
+    for (int i = 0; i < BENCH_INPUTS; i++) {
+        for (int r = 0; r < 4; r++) {
+            for (int c = 0; c < 4; c++)
+                inputs.m[i].e[r][c] = random_float(-1.0f, 1.0f);
+        }
+
+        inputs.pos[i]   = glm::vec3(random_float(-5.0f, 5.0f), random_float(-5.0f, 5.0f), random_float(-5.0f, 5.0f));
+        inputs.dir[i]   = glm::vec3(random_float(0.5f, 2.0f), random_float(0.5f, 2.0f), random_float(0.5f, 2.0f));
+        inputs.plane[i] = glm::vec4(random_float(-1.0f, 1.0f), random_float(-1.0f, 1.0f), random_float(0.5f, 1.0f), random_float(-5.0f, 5.0f));
+        inputs.value[i] = random_float(-90.0f, 90.0f);
+    }
+
+    run_bench(&bench, "operator*", "", "", bench_multiply, &inputs, BENCH_BATCH, bench.samples);
+    run_bench(&bench, "m4x4_transpose", "", "", bench_transpose, &inputs, BENCH_BATCH, bench.samples);
+
+    Transform_Method methods[2] = { GL, CUSTOM };
+    const char *method_names[2] = { "GL", "CUSTOM" };
+
+    for (int m = 0; m < 2; m++) {
+        inputs.method = methods[m];
+        run_bench(&bench, "rotation", method_names[m], "", bench_rotation, &inputs, BENCH_BATCH, bench.samples);
+        run_bench(&bench, "scale", method_names[m], "", bench_scale, &inputs, BENCH_BATCH, bench.samples);
+        run_bench(&bench, "reflection", method_names[m], "", bench_reflection, &inputs, BENCH_BATCH, bench.samples);
+        run_bench(&bench, "shear", method_names[m], "", bench_shear, &inputs, BENCH_BATCH, bench.samples);
+        run_bench(&bench, "translate", method_names[m], "", bench_translate, &inputs, BENCH_BATCH, bench.samples);
+    }
+
+    static Bench_Files txt = {};
+    list_files(&txt, "transforms", ".txt", 0);
+
+    for (int i = 0; i < txt.count; i++) {
+        txt.current = i;
+        arena_reserve(&txt.arena, transform_arena_size(txt.path[i]));
+        run_bench(&bench, "read_txt", "", strrchr(txt.path[i], '/') + 1, bench_read_txt, &txt, 1, bench.samples);
+    }
+
+    static Bench_Files off = {};
+    list_files(&off, bench.corpus, ".off", bench.max_files);
+
+    // Meshes in the corpus differ in size by orders of magnitude, so each file
+    // gets its own result instead of one distribution mixing all of them.
+    for (int i = 0; i < off.count; i++) {
+        const char *file = strrchr(off.path[i], '/') + 1;
+        off.current = i;
+        run_bench(&bench, "read_off", "", file, bench_read_off, &off, 1, bench.samples);
+        run_bench(&bench, "compute_normals", "", file, bench_normals, &off, 1, bench.samples);
+    }
+
+    if (bench.json_path)
+        write_json(&bench);
+
+    return 0;
+}
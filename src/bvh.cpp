@@ -0,0 +1,312 @@
+#if !defined(HEADER_BVH_CPP)
+#define HEADER_BVH_CPP
+
+#define BVH_BINS        16
+#define BVH_LEAF_SIZE   4
+#define BVH_SPAWN_SIZE  4096
+#define BVH_STACK_SIZE  64
+
+typedef struct {
+    glm::vec3 min, max;
+} Bounds;
+
+typedef struct {
+    const Mesh *mesh;
+    Bvh *bvh;
+    Bounds *face_bounds;
+    glm::vec3 *centroid;
+    int num_nodes;
+    int spawn_depth;
+} Bvh_Build;
+
+typedef struct {
+    Bvh_Build *build;
+    int node, begin, end, depth;
+} Bvh_Task;
+
+typedef struct {
+    int hit;
+    int face;
+    float t, u, v;
+} Ray_Hit;
+
+static Bounds bounds_empty(void) {
+    Bounds result = {
+        glm::vec3( INFINITY,  INFINITY,  INFINITY),
+        glm::vec3(-INFINITY, -INFINITY, -INFINITY)
+    };
+    return result;
+}
+
+static void bounds_grow(Bounds *b, glm::vec3 min, glm::vec3 max) {
+    b->min = glm::min(b->min, min);
+    b->max = glm::max(b->max, max);
+}
+
+static float bounds_area(Bounds b) {
+    glm::vec3 d = b.max - b.min;
+    if (d.x < 0.0f) return 0.0f;
+    return d.x * d.y + d.y * d.z + d.z * d.x;
+}
+
+static void compute_face_bounds(void *data, int begin, int end) {
+    Bvh_Build *build = (Bvh_Build *)data;
+    const Mesh *mesh = build->mesh;
+
+    for (int i = begin; i < end; i++) {
+        glm::vec3 p1 = mesh->vertex[mesh->index[i].i1].v;
+        glm::vec3 p2 = mesh->vertex[mesh->index[i].i2].v;
+        glm::vec3 p3 = mesh->vertex[mesh->index[i].i3].v;
+
+        build->face_bounds[i].min = glm::min(p1, glm::min(p2, p3));
+        build->face_bounds[i].max = glm::max(p1, glm::max(p2, p3));
+        build->centroid[i] = (p1 + p2 + p3) / 3.0f;
+        build->bvh->faces[i] = i;
+    }
+}
+
+static int get_bin(float c, float min, float scale) {
+    int result = (int)((c - min) * scale);
+    if (result < 0)         result = 0;
+    if (result >= BVH_BINS) result = BVH_BINS - 1;
+    return result;
+}
+
+static void *build_bvh_task(void *arg);
+
+static void build_bvh_node(Bvh_Build *build, int node_index, int begin, int end, int depth) {
+    Bvh_Node *node = &build->bvh->nodes[node_index];
+    int *faces = build->bvh->faces;
+
+    Bounds bounds = bounds_empty();
+    Bounds centroid_bounds = bounds_empty();
+
+    for (int i = begin; i < end; i++) {
+        Bounds fb = build->face_bounds[faces[i]];
+        bounds_grow(&bounds, fb.min, fb.max);
+        bounds_grow(&centroid_bounds, build->centroid[faces[i]], build->centroid[faces[i]]);
+    }
+
+    node->min = bounds.min;
+    node->max = bounds.max;
+    node->left = begin;
+    node->count = end - begin;
+
+    // Traversal keeps at most one pending sibling per level plus the two
+    // children it pushes, so capping the depth keeps intersect_bvh's stack in
+    // bounds even when a degenerate mesh refuses to split evenly.
+    if (end - begin <= BVH_LEAF_SIZE || depth >= BVH_STACK_SIZE - 2)
+        return;
+
+    float best_cost = (end - begin) * bounds_area(bounds);
+    int best_axis = -1, best_split = 0;
+
+    for (int axis = 0; axis < 3; axis++) {
+        float min = centroid_bounds.min[axis];
+        float extent = centroid_bounds.max[axis] - min;
+
+        if (extent <= 0.0f)
+            continue;
+
+        float scale = BVH_BINS / extent;
+        Bounds bin_bounds[BVH_BINS];
+        int bin_count[BVH_BINS] = {};
+
+        for (int i = 0; i < BVH_BINS; i++)
+            bin_bounds[i] = bounds_empty();
+
+        for (int i = begin; i < end; i++) {
+            int bin = get_bin(build->centroid[faces[i]][axis], min, scale);
+            Bounds fb = build->face_bounds[faces[i]];
+            bounds_grow(&bin_bounds[bin], fb.min, fb.max);
+            bin_count[bin]++;
+        }
+
+        float right_area[BVH_BINS];
+        int right_count[BVH_BINS];
+        Bounds right = bounds_empty();
+        int count = 0;
+
+        for (int i = BVH_BINS - 1; i > 0; i--) {
+            bounds_grow(&right, bin_bounds[i].min, bin_bounds[i].max);
+            count += bin_count[i];
+            right_area[i] = bounds_area(right);
+            right_count[i] = count;
+        }
+
+        Bounds left = bounds_empty();
+        count = 0;
+
+        for (int i = 0; i < BVH_BINS - 1; i++) {
+            bounds_grow(&left, bin_bounds[i].min, bin_bounds[i].max);
+            count += bin_count[i];
+
+            float cost = count * bounds_area(left) + right_count[i + 1] * right_area[i + 1];
+            if (count && right_count[i + 1] && cost < best_cost) {
+                best_cost = cost;
+                best_axis = axis;
+                best_split = i + 1;
+            }
+        }
+    }
+
+    if (best_axis < 0)
+        return;
+
+    float min = centroid_bounds.min[best_axis];
+    float scale = BVH_BINS / (centroid_bounds.max[best_axis] - min);
+
+    int mid = begin;
+    for (int i = begin; i < end; i++) {
+        if (get_bin(build->centroid[faces[i]][best_axis], min, scale) < best_split) {
+            int tmp = faces[i];
+            faces[i] = faces[mid];
+            faces[mid++] = tmp;
+        }
+    }
+
+    int left = __atomic_fetch_add(&build->num_nodes, 2, __ATOMIC_RELAXED);
+    node->left = left;
+    node->count = 0;
+
+    if (depth < build->spawn_depth && end - begin >= BVH_SPAWN_SIZE) {
+        Bvh_Task task = { build, left, begin, mid, depth + 1 };
+        pthread_t thread;
+
+        pthread_create(&thread, 0, build_bvh_task, &task);
+        build_bvh_node(build, left + 1, mid, end, depth + 1);
+        pthread_join(thread, 0);
+    } else {
+        build_bvh_node(build, left, begin, mid, depth + 1);
+        build_bvh_node(build, left + 1, mid, end, depth + 1);
+    }
+}
+
+static void *build_bvh_task(void *arg) {
+    Bvh_Task *task = (Bvh_Task *)arg;
+    build_bvh_node(task->build, task->node, task->begin, task->end, task->depth);
+    return 0;
+}
+
+static void build_bvh(Mesh *mesh) {
+    PROFILE_SCOPE("build_bvh");
+
+    Bvh *bvh = &mesh->bvh;
+    int num_faces = mesh->num_faces;
+
+    bvh->nodes = (Bvh_Node *)malloc((2 * num_faces + 1) * sizeof(Bvh_Node));
+    bvh->faces = (int *)malloc(num_faces * sizeof(int));
+
+    Bvh_Build build = {};
+    build.mesh = mesh;
+    build.bvh = bvh;
+    build.face_bounds = (Bounds *)malloc(num_faces * sizeof(Bounds));
+    build.centroid = (glm::vec3 *)malloc(num_faces * sizeof(glm::vec3));
+    build.num_nodes = 1;
+
+    for (int threads = get_num_threads(); threads > 1; threads /= 2)
+        build.spawn_depth++;
+
+    parallel_for(num_faces, BVH_SPAWN_SIZE, compute_face_bounds, &build);
+    build_bvh_node(&build, 0, 0, num_faces, 0);
+
+    bvh->num_nodes = build.num_nodes;
+
+    free(build.face_bounds);
+    free(build.centroid);
+}
+
+static int intersect_bounds(glm::vec3 min, glm::vec3 max, glm::vec3 origin, glm::vec3 inv_dir, float t_max, float *t_near) {
+    glm::vec3 t1 = (min - origin) * inv_dir;
+    glm::vec3 t2 = (max - origin) * inv_dir;
+    glm::vec3 tmin = glm::min(t1, t2);
+    glm::vec3 tmax = glm::max(t1, t2);
+
+    float enter = fmaxf(fmaxf(tmin.x, tmin.y), fmaxf(tmin.z, 0.0f));
+    float exit  = fminf(fminf(tmax.x, tmax.y), fminf(tmax.z, t_max));
+
+    *t_near = enter;
+    return enter <= exit;
+}
+
+static void intersect_face(const Mesh *mesh, int face, glm::vec3 origin, glm::vec3 dir, Ray_Hit *hit) {
+    glm::vec3 p1 = mesh->vertex[mesh->index[face].i1].v;
+    glm::vec3 p2 = mesh->vertex[mesh->index[face].i2].v;
+    glm::vec3 p3 = mesh->vertex[mesh->index[face].i3].v;
+
+    glm::vec3 e1 = p2 - p1;
+    glm::vec3 e2 = p3 - p1;
+    glm::vec3 p = glm::cross(dir, e2);
+    float det = glm::dot(e1, p);
+
+    if (fabsf(det) < 1e-12f)
+        return;
+
+    float inv_det = 1.0f / det;
+    glm::vec3 s = origin - p1;
+    float u = glm::dot(s, p) * inv_det;
+    if (u < 0.0f || u > 1.0f)
+        return;
+
+    glm::vec3 q = glm::cross(s, e1);
+    float v = glm::dot(dir, q) * inv_det;
+    if (v < 0.0f || u + v > 1.0f)
+        return;
+
+    float t = glm::dot(e2, q) * inv_det;
+    if (t > 0.0f && t < hit->t) {
+        hit->hit = true;
+        hit->face = face;
+        hit->t = t;
+        hit->u = u;
+        hit->v = v;
+    }
+}
+
+static Ray_Hit intersect_bvh(const Mesh *mesh, glm::vec3 origin, glm::vec3 dir) {
+    const Bvh *bvh = &mesh->bvh;
+    Ray_Hit hit = {};
+    hit.t = INFINITY;
+
+    glm::vec3 inv_dir = glm::vec3(1.0f / dir.x, 1.0f / dir.y, 1.0f / dir.z);
+    int stack[BVH_STACK_SIZE];
+    int top = 0;
+    float t_near;
+
+    if (!bvh->num_nodes || !intersect_bounds(bvh->nodes[0].min, bvh->nodes[0].max, origin, inv_dir, hit.t, &t_near))
+        return hit;
+
+    stack[top++] = 0;
+
+    while (top) {
+        const Bvh_Node *node = &bvh->nodes[stack[--top]];
+
+        if (node->count) {
+            for (int i = node->left; i < node->left + node->count; i++)
+                intersect_face(mesh, bvh->faces[i], origin, dir, &hit);
+            continue;
+        }
+
+        float t_left, t_right;
+        int left  = intersect_bounds(bvh->nodes[node->left].min, bvh->nodes[node->left].max, origin, inv_dir, hit.t, &t_left);
+        int right = intersect_bounds(bvh->nodes[node->left + 1].min, bvh->nodes[node->left + 1].max, origin, inv_dir, hit.t, &t_right);
+
+        if (left && right) {
+            if (t_left < t_right) {
+                stack[top++] = node->left + 1;
+                stack[top++] = node->left;
+            } else {
+                stack[top++] = node->left;
+                stack[top++] = node->left + 1;
+            }
+        } else if (left) {
+            stack[top++] = node->left;
+        } else if (right) {
+            stack[top++] = node->left + 1;
+        }
+    }
+
+    return hit;
+}
+
+#endif
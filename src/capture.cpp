@@ -0,0 +1,524 @@
+#if !defined(HEADER_CAPTURE_CPP)
+#define HEADER_CAPTURE_CPP
+
+#define CAPTURE_NAMES   256
+#define CAPTURE_OBJECTS 4096
+
+typedef enum {
+    CMD_FRAME,
+    CMD_GEN_VERTEX_ARRAY,
+    CMD_GEN_BUFFER,
+    CMD_BIND_VERTEX_ARRAY,
+    CMD_BIND_BUFFER,
+    CMD_BUFFER_DATA,
+    CMD_ATTRIB_POINTER,
+    CMD_ENABLE_ATTRIB,
+    CMD_PROGRAM,
+    CMD_USE_PROGRAM,
+    CMD_NAME,
+    CMD_UNIFORM_MAT4,
+    CMD_UNIFORM_VEC3,
+    CMD_VIEWPORT,
+    CMD_SCISSOR,
+    CMD_CLEAR_COLOR,
+    CMD_CLEAR,
+    CMD_ENABLE,
+    CMD_DISABLE,
+    CMD_POINT_SIZE,
+    CMD_DRAW_ELEMENTS,
+    CMD_DRAW_ARRAYS
+} Capture_Command;
+
+typedef struct {
+    char magic[4];
+    unsigned int version;
+    int width, height;
+} Capture_Header;
+
+typedef struct {
+    FILE *file;
+    const char *path;
+    int frames;
+
+    const char *names[CAPTURE_NAMES];
+    int num_names;
+} Capture;
+
+typedef struct {
+    unsigned char *data;
+    size_t size, cursor;
+    const char *path;
+    int width, height;
+} Trace;
+
+static Capture capture;
+
+static unsigned int link_program(const char *vertex, const char *fragment);
+
+static void capture_begin(const char *path, int width, int height) {
+    if (!path)
+        return;
+
+    capture.file = fopen(path, "wb");
+    capture.path = path;
+
+    if (!capture.file) {
+        fprintf(stderr, "ERROR: %s file failed to open!\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    Capture_Header header = { {'G', 'L', 'T', '1'}, 1, width, height };
+    fwrite(&header, sizeof(header), 1, capture.file);
+}
+
+static void capture_end(void) {
+    if (!capture.file)
+        return;
+
+    long size = ftell(capture.file);
+    fclose(capture.file);
+    capture.file = 0;
+
+    fprintf(stdout, "CAPTURE %s: %d frames, %ld bytes\n", capture.path, capture.frames, size);
+}
+
+static void capture_write(const void *data, size_t size) {
+    fwrite(data, size, 1, capture.file);
+}
+
+static void capture_command(unsigned char command) {
+    capture_write(&command, 1);
+}
+
+static void capture_u32(unsigned int value) {
+    capture_write(&value, sizeof(value));
+}
+
+static void capture_frame(void) {
+    if (!capture.file)
+        return;
+
+    capture_command(CMD_FRAME);
+    capture.frames++;
+}
+
+// Uniform names are sent once and referred to by index afterwards.
+static unsigned short capture_name(const char *name) {
+    for (int i = 0; i < capture.num_names; i++) {
+        if (capture.names[i] == name || !strcmp(capture.names[i], name))
+            return i;
+    }
+
+    if (capture.num_names == CAPTURE_NAMES) {
+        fprintf(stderr, "ERROR: Too many uniform names in capture!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    unsigned short index = capture.num_names++;
+    unsigned char len = strlen(name);
+    capture.names[index] = name;
+
+    capture_command(CMD_NAME);
+    capture_write(&index, sizeof(index));
+    capture_write(&len, 1);
+    capture_write(name, len);
+
+    return index;
+}
+
+static void capture_gen_vertex_array(unsigned int *vao) {
+    glGenVertexArrays(1, vao);
+    if (!capture.file) return;
+    capture_command(CMD_GEN_VERTEX_ARRAY);
+    capture_u32(*vao);
+}
+
+static void capture_gen_buffer(unsigned int *buffer) {
+    glGenBuffers(1, buffer);
+    if (!capture.file) return;
+    capture_command(CMD_GEN_BUFFER);
+    capture_u32(*buffer);
+}
+
+static void capture_bind_vertex_array(unsigned int vao) {
+    glBindVertexArray(vao);
+    if (!capture.file) return;
+    capture_command(CMD_BIND_VERTEX_ARRAY);
+    capture_u32(vao);
+}
+
+static void capture_bind_buffer(unsigned int target, unsigned int buffer) {
+    glBindBuffer(target, buffer);
+    if (!capture.file) return;
+    capture_command(CMD_BIND_BUFFER);
+    capture_u32(target);
+    capture_u32(buffer);
+}
+
+static void capture_buffer_data(unsigned int target, unsigned long long size, const void *data, unsigned int usage) {
+    glBufferData(target, size, data, usage);
+    if (!capture.file) return;
+    capture_command(CMD_BUFFER_DATA);
+    capture_u32(target);
+    capture_u32(usage);
+    capture_write(&size, sizeof(size));
+    capture_write(data, size);
+}
+
+static void capture_attrib_pointer(unsigned int index, int size, unsigned int type, int stride, unsigned long long offset) {
+    glVertexAttribPointer(index, size, type, GL_FALSE, stride, (void *)offset);
+    if (!capture.file) return;
+    capture_command(CMD_ATTRIB_POINTER);
+    capture_u32(index);
+    capture_u32(size);
+    capture_u32(type);
+    capture_u32(stride);
+    capture_write(&offset, sizeof(offset));
+}
+
+static void capture_enable_attrib(unsigned int index) {
+    glEnableVertexAttribArray(index);
+    if (!capture.file) return;
+    capture_command(CMD_ENABLE_ATTRIB);
+    capture_u32(index);
+}
+
+// Programs are recorded as their linked sources rather than as the
+// individual compile and link calls.
+static void capture_program(unsigned int program, const char *vertex, const char *fragment) {
+    if (!capture.file) return;
+
+    unsigned int vlen = strlen(vertex);
+    unsigned int flen = strlen(fragment);
+
+    capture_command(CMD_PROGRAM);
+    capture_u32(program);
+    capture_u32(vlen);
+    capture_write(vertex, vlen);
+    capture_u32(flen);
+    capture_write(fragment, flen);
+}
+
+static void capture_use_program(unsigned int program) {
+    glUseProgram(program);
+    if (!capture.file) return;
+    capture_command(CMD_USE_PROGRAM);
+    capture_u32(program);
+}
+
+static void capture_uniform_mat4(unsigned int program, const char *name, glm::mat4 matrix) {
+    glUniformMatrix4fv(glGetUniformLocation(program, name), 1, GL_FALSE, glm::value_ptr(matrix));
+    if (!capture.file) return;
+    unsigned short index = capture_name(name);
+    capture_command(CMD_UNIFORM_MAT4);
+    capture_write(&index, sizeof(index));
+    capture_write(glm::value_ptr(matrix), 16 * sizeof(float));
+}
+
+static void capture_uniform_vec3(unsigned int program, const char *name, glm::vec3 v) {
+    glUniform3fv(glGetUniformLocation(program, name), 1, glm::value_ptr(v));
+    if (!capture.file) return;
+    unsigned short index = capture_name(name);
+    capture_command(CMD_UNIFORM_VEC3);
+    capture_write(&index, sizeof(index));
+    capture_write(glm::value_ptr(v), 3 * sizeof(float));
+}
+
+static void capture_viewport(int x, int y, int width, int height) {
+    glViewport(x, y, width, height);
+    if (!capture.file) return;
+    int rect[4] = { x, y, width, height };
+    capture_command(CMD_VIEWPORT);
+    capture_write(rect, sizeof(rect));
+}
+
+static void capture_scissor(int x, int y, int width, int height) {
+    glScissor(x, y, width, height);
+    if (!capture.file) return;
+    int rect[4] = { x, y, width, height };
+    capture_command(CMD_SCISSOR);
+    capture_write(rect, sizeof(rect));
+}
+
+static void capture_clear_color(glm::vec4 color) {
+    glClearColor(color[0], color[1], color[2], color[3]);
+    if (!capture.file) return;
+    capture_command(CMD_CLEAR_COLOR);
+    capture_write(glm::value_ptr(color), 4 * sizeof(float));
+}
+
+static void capture_clear(unsigned int mask) {
+    glClear(mask);
+    if (!capture.file) return;
+    capture_command(CMD_CLEAR);
+    capture_u32(mask);
+}
+
+static void capture_enable(unsigned int cap, int enable) {
+    if (enable) glEnable(cap);
+    else        glDisable(cap);
+    if (!capture.file) return;
+    capture_command(enable ? CMD_ENABLE : CMD_DISABLE);
+    capture_u32(cap);
+}
+
+static void capture_point_size(float size) {
+    glPointSize(size);
+    if (!capture.file) return;
+    capture_command(CMD_POINT_SIZE);
+    capture_write(&size, sizeof(size));
+}
+
+static void capture_draw_elements(unsigned int mode, int count, unsigned int type, unsigned long long offset) {
+    glDrawElements(mode, count, type, (void *)offset);
+    if (!capture.file) return;
+    capture_command(CMD_DRAW_ELEMENTS);
+    capture_u32(mode);
+    capture_u32(count);
+    capture_u32(type);
+    capture_write(&offset, sizeof(offset));
+}
+
+static void capture_draw_arrays(unsigned int mode, int first, int count) {
+    glDrawArrays(mode, first, count);
+    if (!capture.file) return;
+    capture_command(CMD_DRAW_ARRAYS);
+    capture_u32(mode);
+    capture_u32(first);
+    capture_u32(count);
+}
+
+static void open_trace(const char *path, Trace *trace) {
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: %s file failed to open!\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    struct stat st;
+    fstat(fd, &st);
+    trace->size = st.st_size;
+    trace->path = path;
+
+    void *data = trace->size >= sizeof(Capture_Header) ? mmap(0, trace->size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "ERROR: %s could not be mapped!\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    Capture_Header *header = (Capture_Header *)data;
+
+    if (memcmp(header->magic, "GLT1", 4) || header->version != 1) {
+        fprintf(stderr, "ERROR: %s is not a valid trace file!\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    madvise(data, trace->size, MADV_SEQUENTIAL);
+
+    trace->data = (unsigned char *)data;
+    trace->cursor = sizeof(Capture_Header);
+    trace->width = header->width;
+    trace->height = header->height;
+}
+
+static const unsigned char *trace_read(Trace *trace, size_t size) {
+    if (trace->size - trace->cursor < size) {
+        fprintf(stderr, "ERROR: %s is truncated!\n", trace->path);
+        exit(EXIT_FAILURE);
+    }
+
+    const unsigned char *result = trace->data + trace->cursor;
+    trace->cursor += size;
+    return result;
+}
+
+static unsigned int trace_u32(Trace *trace) {
+    unsigned int result;
+    memcpy(&result, trace_read(trace, sizeof(result)), sizeof(result));
+    return result;
+}
+
+static unsigned long long trace_u64(Trace *trace) {
+    unsigned long long result;
+    memcpy(&result, trace_read(trace, sizeof(result)), sizeof(result));
+    return result;
+}
+
+static float trace_f32(Trace *trace) {
+    float result;
+    memcpy(&result, trace_read(trace, sizeof(result)), sizeof(result));
+    return result;
+}
+
+static unsigned short trace_name(Trace *trace) {
+    unsigned short result;
+    memcpy(&result, trace_read(trace, sizeof(result)), sizeof(result));
+
+    if (result >= CAPTURE_NAMES) {
+        fprintf(stderr, "ERROR: %s has an invalid uniform name!\n", trace->path);
+        exit(EXIT_FAILURE);
+    }
+
+    return result;
+}
+
+static unsigned int *trace_object(Trace *trace, unsigned int *map, unsigned int id) {
+    if (id >= CAPTURE_OBJECTS) {
+        fprintf(stderr, "ERROR: %s has an invalid object id %u!\n", trace->path, id);
+        exit(EXIT_FAILURE);
+    }
+
+    return &map[id];
+}
+
+typedef struct {
+    unsigned int vao[CAPTURE_OBJECTS];
+    unsigned int buffer[CAPTURE_OBJECTS];
+    unsigned int program[CAPTURE_OBJECTS];
+    char names[CAPTURE_NAMES][256];
+    unsigned int current;
+} Replay;
+
+// Re-issues commands up to and including the next frame marker, or up to the
+// end of the trace.
+static void replay_frame(Trace *trace, Replay *replay) {
+    while (trace->cursor < trace->size) {
+        unsigned char command = *trace_read(trace, 1);
+
+        switch (command) {
+        case CMD_FRAME:
+            return;
+
+        case CMD_GEN_VERTEX_ARRAY:
+            glGenVertexArrays(1, trace_object(trace, replay->vao, trace_u32(trace)));
+            break;
+
+        case CMD_GEN_BUFFER:
+            glGenBuffers(1, trace_object(trace, replay->buffer, trace_u32(trace)));
+            break;
+
+        case CMD_BIND_VERTEX_ARRAY:
+            glBindVertexArray(*trace_object(trace, replay->vao, trace_u32(trace)));
+            break;
+
+        case CMD_BIND_BUFFER: {
+            unsigned int target = trace_u32(trace);
+            glBindBuffer(target, *trace_object(trace, replay->buffer, trace_u32(trace)));
+        } break;
+
+        case CMD_BUFFER_DATA: {
+            unsigned int target = trace_u32(trace);
+            unsigned int usage = trace_u32(trace);
+            unsigned long long size = trace_u64(trace);
+            glBufferData(target, size, trace_read(trace, size), usage);
+        } break;
+
+        case CMD_ATTRIB_POINTER: {
+            unsigned int index = trace_u32(trace);
+            int size = trace_u32(trace);
+            unsigned int type = trace_u32(trace);
+            int stride = trace_u32(trace);
+            unsigned long long offset = trace_u64(trace);
+            glVertexAttribPointer(index, size, type, GL_FALSE, stride, (void *)offset);
+        } break;
+
+        case CMD_ENABLE_ATTRIB:
+            glEnableVertexAttribArray(trace_u32(trace));
+            break;
+
+        case CMD_PROGRAM: {
+            unsigned int *program = trace_object(trace, replay->program, trace_u32(trace));
+
+            unsigned int vlen = trace_u32(trace);
+            char *vertex = strndup((const char *)trace_read(trace, vlen), vlen);
+            unsigned int flen = trace_u32(trace);
+            char *fragment = strndup((const char *)trace_read(trace, flen), flen);
+
+            *program = link_program(vertex, fragment);
+
+            free(vertex);
+            free(fragment);
+        } break;
+
+        case CMD_USE_PROGRAM:
+            replay->current = *trace_object(trace, replay->program, trace_u32(trace));
+            glUseProgram(replay->current);
+            break;
+
+        case CMD_NAME: {
+            unsigned short index = trace_name(trace);
+            unsigned char len = *trace_read(trace, 1);
+            memcpy(replay->names[index], trace_read(trace, len), len);
+            replay->names[index][len] = 0;
+        } break;
+
+        case CMD_UNIFORM_MAT4: {
+            const char *name = replay->names[trace_name(trace)];
+            float m[16];
+            memcpy(m, trace_read(trace, sizeof(m)), sizeof(m));
+            glUniformMatrix4fv(glGetUniformLocation(replay->current, name), 1, GL_FALSE, m);
+        } break;
+
+        case CMD_UNIFORM_VEC3: {
+            const char *name = replay->names[trace_name(trace)];
+            float v[3];
+            memcpy(v, trace_read(trace, sizeof(v)), sizeof(v));
+            glUniform3fv(glGetUniformLocation(replay->current, name), 1, v);
+        } break;
+
+        case CMD_VIEWPORT:
+        case CMD_SCISSOR: {
+            int rect[4];
+            memcpy(rect, trace_read(trace, sizeof(rect)), sizeof(rect));
+            if (command == CMD_VIEWPORT) glViewport(rect[0], rect[1], rect[2], rect[3]);
+            else                         glScissor(rect[0], rect[1], rect[2], rect[3]);
+        } break;
+
+        case CMD_CLEAR_COLOR: {
+            float c[4];
+            memcpy(c, trace_read(trace, sizeof(c)), sizeof(c));
+            glClearColor(c[0], c[1], c[2], c[3]);
+        } break;
+
+        case CMD_CLEAR:
+            glClear(trace_u32(trace));
+            break;
+
+        case CMD_ENABLE:
+            glEnable(trace_u32(trace));
+            break;
+
+        case CMD_DISABLE:
+            glDisable(trace_u32(trace));
+            break;
+
+        case CMD_POINT_SIZE:
+            glPointSize(trace_f32(trace));
+            break;
+
+        case CMD_DRAW_ELEMENTS: {
+            unsigned int mode = trace_u32(trace);
+            int count = trace_u32(trace);
+            unsigned int type = trace_u32(trace);
+            unsigned long long offset = trace_u64(trace);
+            glDrawElements(mode, count, type, (void *)offset);
+        } break;
+
+        case CMD_DRAW_ARRAYS: {
+            unsigned int mode = trace_u32(trace);
+            int first = trace_u32(trace);
+            int count = trace_u32(trace);
+            glDrawArrays(mode, first, count);
+        } break;
+
+        default:
+            fprintf(stderr, "ERROR: %s has an unknown command %d!\n", trace->path, command);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+#endif
@@ -0,0 +1,33 @@
+#if !defined(HEADER_COMMON_H)
+#define HEADER_COMMON_H
+
+#include <assert.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <pthread.h>
+#include <unistd.h>
+#include <time.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtx/transform2.hpp>
+#include <glm/gtc/type_ptr.hpp>
+
+#include "matrix.h"
+
+typedef enum {
+    GL,
+    CUSTOM
+} Transform_Method;
+
+typedef struct {
+    char *base;
+    size_t used, committed, capacity;
+} Arena;
+
+#endif
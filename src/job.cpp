@@ -0,0 +1,65 @@
+#if !defined(HEADER_JOB_CPP)
+#define HEADER_JOB_CPP
+
+#define MAX_THREADS 64
+
+typedef void (*Job_Func)(void *data, int begin, int end);
+
+typedef struct {
+    Job_Func func;
+    void *data;
+    int begin, end;
+    pthread_t thread;
+} Job;
+
+static int get_num_threads(void) {
+    long count = sysconf(_SC_NPROCESSORS_ONLN);
+
+    if (count < 1)           count = 1;
+    if (count > MAX_THREADS) count = MAX_THREADS;
+
+    return count;
+}
+
+static void *job_entry(void *arg) {
+    Job *job = (Job *)arg;
+    job->func(job->data, job->begin, job->end);
+    return 0;
+}
+
+// Splits [0, count) over up to num_threads OS threads, the caller included.
+static void parallel_for_threads(int count, int num_threads, int min_batch, Job_Func func, void *data) {
+    int num_jobs = num_threads < MAX_THREADS ? num_threads : MAX_THREADS;
+
+    if (min_batch < 1) min_batch = 1;
+    if (num_jobs > count / min_batch) num_jobs = count / min_batch;
+
+    if (num_jobs <= 1) {
+        func(data, 0, count);
+        return;
+    }
+
+    Job jobs[MAX_THREADS];
+    int batch = (count + num_jobs - 1) / num_jobs;
+
+    for (int i = 0; i < num_jobs; i++) {
+        jobs[i].func  = func;
+        jobs[i].data  = data;
+        jobs[i].begin = i * batch < count ? i * batch : count;
+        jobs[i].end   = (i + 1) * batch < count ? (i + 1) * batch : count;
+
+        if (i > 0)
+            pthread_create(&jobs[i].thread, 0, job_entry, &jobs[i]);
+    }
+
+    job_entry(&jobs[0]);
+
+    for (int i = 1; i < num_jobs; i++)
+        pthread_join(jobs[i].thread, 0);
+}
+
+static void parallel_for(int count, int min_batch, Job_Func func, void *data) {
+    parallel_for_threads(count, get_num_threads(), min_batch, func, data);
+}
+
+#endif
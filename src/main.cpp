@@ -1,11 +1,28 @@
 #include "main.h"
+#include "timer.cpp"
+#include "profile.cpp"
+#include "profile_gl.cpp"
+#include "arena.cpp"
 #include "read.cpp"
 #include "transform.cpp"
+#include "job.cpp"
+#include "simplify.cpp"
+#include "bvh.cpp"
+#include "weld.cpp"
+#include "raster.cpp"
+#include "capture.cpp"
+#include "reload.cpp"
+#include "snapshot.cpp"
 
 static void error_callback(int error, const char *desc) {
     fprintf(stderr, "Error: %s\n", desc);
 }
 
+static void refresh_callback(GLFWwindow *window) {
+    GL_Context *context = (GL_Context *)glfwGetWindowUserPointer(window);
+    context->dirty = true;
+}
+
 static void init_glcontext(GL_Context *context, const char *title, int major, int minor) {
     glfwInit();
 
@@ -21,6 +38,8 @@ static void init_glcontext(GL_Context *context, const char *title, int major, in
     context->window = glfwCreateWindow(context->width, context->height, title, 0, 0);
 
     glfwSetErrorCallback(error_callback);
+    glfwSetWindowUserPointer(context->window, context);
+    glfwSetWindowRefreshCallback(context->window, refresh_callback);
 
     glfwMakeContextCurrent(context->window);
     glewInit();
@@ -29,28 +48,220 @@ static void init_glcontext(GL_Context *context, const char *title, int major, in
     glEnable(GL_SCISSOR_TEST);
 }
 
-static void init_mesh_buffer(const char *path, Mesh *mesh) {
-    read_off(path, mesh);
+static void init_glcontext_headless(GL_Context *context, int width, int height, int major, int minor) {
+    PFNEGLGETPLATFORMDISPLAYEXTPROC get_platform_display =
+        (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+    if (get_platform_display)
+        context->display = get_platform_display(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, 0);
+    if (!context->display)
+        context->display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+
+    if (!eglInitialize(context->display, 0, 0)) {
+        fprintf(stderr, "ERROR: EGL initialization failed!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    eglBindAPI(EGL_OPENGL_API);
+
+    EGLint attribs[] = {
+        EGL_CONTEXT_MAJOR_VERSION, major,
+        EGL_CONTEXT_MINOR_VERSION, minor,
+        EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+        EGL_NONE
+    };
+
+    context->egl = eglCreateContext(context->display, 0, EGL_NO_CONTEXT, attribs);
+
+    if (!context->egl || !eglMakeCurrent(context->display, EGL_NO_SURFACE, EGL_NO_SURFACE, context->egl)) {
+        fprintf(stderr, "ERROR: EGL surfaceless context creation failed!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    glewExperimental = GL_TRUE;
+    glewInit();
+
+    context->width = width;
+    context->height = height;
+
+    glGenFramebuffers(1, &context->fbo);
+    glGenRenderbuffers(1, &context->color);
+    glGenRenderbuffers(1, &context->depth);
+
+    glBindRenderbuffer(GL_RENDERBUFFER, context->color);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+    glBindRenderbuffer(GL_RENDERBUFFER, context->depth);
+    glRenderbufferStorage(GL_RENDERBUFFER, GL_DEPTH_COMPONENT24, width, height);
+
+    glBindFramebuffer(GL_FRAMEBUFFER, context->fbo);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, context->color);
+    glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_DEPTH_ATTACHMENT, GL_RENDERBUFFER, context->depth);
+
+    if (glCheckFramebufferStatus(GL_FRAMEBUFFER) != GL_FRAMEBUFFER_COMPLETE) {
+        fprintf(stderr, "ERROR: Offscreen framebuffer is incomplete!\n");
+        exit(EXIT_FAILURE);
+    }
+
+    glEnable(GL_DEPTH_TEST);
+    glEnable(GL_SCISSOR_TEST);
+}
+
+static void parse_options(Options *options, int argc, char **argv) {
+    options->weld_epsilon = 1e-6f;
+    options->frames = 300;
+    options->mesh_path = "off/38.off";
+    options->transform_path = "transforms/transformations2.txt";
+
+    for (int i = 1; i < argc; i++) {
+        if (!strcmp(argv[i], "--transform") && i + 1 < argc) {
+            options->transform_path = argv[++i];
+        } else if (!strcmp(argv[i], "--convert-transform") && i + 2 < argc) {
+            options->convert_path[0] = argv[++i];
+            options->convert_path[1] = argv[++i];
+        } else if (!strcmp(argv[i], "--trace") && i + 1 < argc) {
+            options->trace_path = argv[++i];
+        } else if (!strcmp(argv[i], "--headless")) {
+            options->headless = true;
+        } else if (!strcmp(argv[i], "--frames") && i + 1 < argc) {
+            options->frames = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--dump") && i + 1 < argc) {
+            options->dump_dir = argv[++i];
+        } else if (!strcmp(argv[i], "--timings") && i + 1 < argc) {
+            options->timings_path = argv[++i];
+        } else if (!strcmp(argv[i], "--mesh") && i + 1 < argc) {
+            options->mesh_path = argv[++i];
+        } else if (!strcmp(argv[i], "--watch")) {
+            options->watch = true;
+        } else if (!strcmp(argv[i], "--capture") && i + 1 < argc) {
+            options->capture_path = argv[++i];
+        } else if (!strcmp(argv[i], "--replay") && i + 1 < argc) {
+            options->replay_path = argv[++i];
+        } else if (!strcmp(argv[i], "--software") && i + 1 < argc) {
+            options->software_path = argv[++i];
+        } else if (!strcmp(argv[i], "--software-threads") && i + 1 < argc) {
+            options->software_threads = atoi(argv[++i]);
+        } else if (!strcmp(argv[i], "--software-scaling")) {
+            options->software_scaling = true;
+        } else if (!strcmp(argv[i], "--threaded")) {
+            options->threaded = true;
+        } else if (!strcmp(argv[i], "--on-demand")) {
+            options->on_demand = true;
+        } else if (!strcmp(argv[i], "--fps") && i + 1 < argc) {
+            options->fps_cap = atof(argv[++i]);
+        } else if (!strcmp(argv[i], "--weld")) {
+            options->weld = true;
+        } else if (!strcmp(argv[i], "--weld-epsilon") && i + 1 < argc) {
+            options->weld = true;
+            options->weld_epsilon = atof(argv[++i]);
+
+            if (!(options->weld_epsilon > 0.0f)) {
+                fprintf(stderr, "ERROR: --weld-epsilon must be greater than zero!\n");
+                exit(EXIT_FAILURE);
+            }
+        } else {
+            fprintf(stderr, "ERROR: Unknown option %s!\n", argv[i]);
+            exit(EXIT_FAILURE);
+        }
+    }
+}
+
+static int load_mesh(const char *path, Mesh *mesh, Options *options) {
+    if (!read_off(path, mesh))
+        return false;
+
+    double tstart, tend;
+
+    if (options->weld) {
+        int num_vertex = mesh->num_vertex;
+        int num_faces = mesh->num_faces;
+
+        tstart = get_time() * 1000.0;
+        clean_mesh(mesh, options->weld_epsilon);
+        tend = get_time() * 1000.0;
+        fprintf(stdout, "%s CLEANUP: vertices %d -> %d, faces %d -> %d (%fms)\n",
+                path, num_vertex, mesh->num_vertex, num_faces, mesh->num_faces, tend - tstart);
+    }
+
+    build_lods(mesh);
+
+    tstart = get_time() * 1000.0;
+    build_bvh(mesh);
+    tend = get_time() * 1000.0;
+    fprintf(stdout, "%s BVH: %d nodes (%fms)\n", path, mesh->bvh.num_nodes, tend - tstart);
+
+    for (int i = 0; i < mesh->num_lod; i++)
+        fprintf(stdout, "%s LOD %d: %d triangles, error %f\n", path, i, mesh->lod[i].num_faces, mesh->lod[i].error);
+
+    return true;
+}
+
+// Both sides show the same file, so the second one copies the first instead of
+// simplifying and building a BVH for it again.
+static void copy_mesh(Mesh *dst, const Mesh *src) {
+    int num_index = get_lod_faces(src);
+
+    *dst = *src;
+    dst->index = (Index3 *)malloc(num_index * sizeof(Index3));
+    dst->vertex = (Vertex3 *)malloc(src->num_vertex * sizeof(Vertex3));
+    dst->bvh.nodes = (Bvh_Node *)malloc(src->bvh.num_nodes * sizeof(Bvh_Node));
+    dst->bvh.faces = (int *)malloc(src->num_faces * sizeof(int));
+
+    memcpy(dst->index, src->index, num_index * sizeof(Index3));
+    memcpy(dst->vertex, src->vertex, src->num_vertex * sizeof(Vertex3));
+    memcpy(dst->bvh.nodes, src->bvh.nodes, src->bvh.num_nodes * sizeof(Bvh_Node));
+    memcpy(dst->bvh.faces, src->bvh.faces, src->num_faces * sizeof(int));
+
+    dst->vao = dst->vbo = dst->ebo = 0;
+}
 
+static void upload_mesh(Mesh *mesh) {
     unsigned int vao, vbo, ebo;
-    glGenVertexArrays(1, &vao);
-    glGenBuffers(1, &vbo);
-    glGenBuffers(1, &ebo);
+    capture_gen_vertex_array(&vao);
+    capture_gen_buffer(&vbo);
+    capture_gen_buffer(&ebo);
 
-    glBindVertexArray(vao);
-    glBindBuffer(GL_ARRAY_BUFFER, vbo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
+    capture_bind_vertex_array(vao);
+    capture_bind_buffer(GL_ARRAY_BUFFER, vbo);
+    capture_bind_buffer(GL_ELEMENT_ARRAY_BUFFER, ebo);
 
-    glBufferData(GL_ARRAY_BUFFER, sizeof(Vertex3) * mesh->num_vertex, mesh->vertex, GL_DYNAMIC_DRAW);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, sizeof(Index3) * mesh->num_faces,  mesh->index,  GL_DYNAMIC_DRAW);
+    capture_buffer_data(GL_ARRAY_BUFFER, sizeof(Vertex3) * mesh->num_vertex, mesh->vertex, GL_DYNAMIC_DRAW);
+    capture_buffer_data(GL_ELEMENT_ARRAY_BUFFER, sizeof(Index3) * get_lod_faces(mesh), mesh->index,  GL_DYNAMIC_DRAW);
 
-    glVertexAttribPointer(0, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), 0);
-    glVertexAttribPointer(1, 3, GL_FLOAT, GL_FALSE, 6 * sizeof(float), (void *)(3 * sizeof(float)));
+    capture_attrib_pointer(0, 3, GL_FLOAT, 6 * sizeof(float), 0);
+    capture_attrib_pointer(1, 3, GL_FLOAT, 6 * sizeof(float), 3 * sizeof(float));
 
-    glEnableVertexAttribArray(0);
-    glEnableVertexAttribArray(1);
+    capture_enable_attrib(0);
+    capture_enable_attrib(1);
 
     mesh->vao = vao;
+    mesh->vbo = vbo;
+    mesh->ebo = ebo;
+}
+
+static void init_mesh_buffers(const char *path, Mesh *mesh, Options *options) {
+    if (!load_mesh(path, &mesh[LEFT], options))
+        exit(EXIT_FAILURE);
+
+    copy_mesh(&mesh[RIGHT], &mesh[LEFT]);
+    upload_mesh(&mesh[LEFT]);
+    upload_mesh(&mesh[RIGHT]);
+}
+
+static void free_mesh_data(Mesh *mesh) {
+    free(mesh->index);
+    free(mesh->vertex);
+    free(mesh->bvh.nodes);
+    free(mesh->bvh.faces);
+
+    *mesh = {};
+}
+
+static void free_mesh(Mesh *mesh) {
+    glDeleteVertexArrays(1, &mesh->vao);
+    glDeleteBuffers(1, &mesh->vbo);
+    glDeleteBuffers(1, &mesh->ebo);
+
+    free_mesh_data(mesh);
 }
 
 static void init_camera(Camera *c) {
@@ -58,6 +269,7 @@ static void init_camera(Camera *c) {
     c->front = { 0.0f, 0.0f, -1.0f };
     c->up    = { 0.0f, 1.0f,  0.0f };
     c->yaw   = -90.0f;
+    c->fov   = 45.0f;
 }
 
 static unsigned int compile_shader(int type, const char *source) {
@@ -77,11 +289,9 @@ static unsigned int compile_shader(int type, const char *source) {
     return id;
 }
 
-static unsigned int create_shader(const char *path) {
-    Shader_Source source = parse_glsl(path);
-
-    unsigned int vid = compile_shader(GL_VERTEX_SHADER, source.vertex);
-    unsigned int fid = compile_shader(GL_FRAGMENT_SHADER, source.fragment);
+static unsigned int link_program(const char *vertex, const char *fragment) {
+    unsigned int vid = compile_shader(GL_VERTEX_SHADER, vertex);
+    unsigned int fid = compile_shader(GL_FRAGMENT_SHADER, fragment);
     unsigned int pid = glCreateProgram();
 
     glAttachShader(pid, vid);
@@ -95,56 +305,141 @@ static unsigned int create_shader(const char *path) {
     return pid;
 }
 
+// Issues compile and link without querying their status, so a driver with
+// KHR_parallel_shader_compile can finish them in the background.
+static unsigned int begin_program(const char *vertex, const char *fragment) {
+    unsigned int vid = glCreateShader(GL_VERTEX_SHADER);
+    glShaderSource(vid, 1, &vertex, 0);
+    glCompileShader(vid);
+
+    unsigned int fid = glCreateShader(GL_FRAGMENT_SHADER);
+    glShaderSource(fid, 1, &fragment, 0);
+    glCompileShader(fid);
+
+    unsigned int pid = glCreateProgram();
+    glAttachShader(pid, vid);
+    glAttachShader(pid, fid);
+    glLinkProgram(pid);
+
+    glDeleteShader(vid);
+    glDeleteShader(fid);
+
+    return pid;
+}
+
+static int is_program_ready(unsigned int pid) {
+    if (!GLEW_KHR_parallel_shader_compile)
+        return true;
+
+    int is_ready;
+    glGetProgramiv(pid, GL_COMPLETION_STATUS_KHR, &is_ready);
+    return is_ready;
+}
+
+static unsigned int create_shader(const char *path) {
+    Shader_Source source = parse_glsl(path);
+
+    if (!source.vertex)
+        exit(EXIT_FAILURE);
+
+    unsigned int pid = link_program(source.vertex, source.fragment);
+    capture_program(pid, source.vertex, source.fragment);
+    return pid;
+}
+
 static void init_scene(Scene *scene, const char *path, glm::vec3 light_color, glm::vec3 light_pos, glm::vec3 object_color, glm::vec4 clear) {
-    scene->shader = create_shader(path);
+    scene->shader = path ? create_shader(path) : 0;
     scene->light_pos = light_pos;
     scene->light_color = light_color;
     scene->object_color = object_color;
     scene->clear = clear;
 }
 
-static void init_transform_queue(Transform *m) {
-    for (int i = 0; i < m->size; i++)
-        m->queue[i] = m4x4_identity();
+static void set_transforms(Transform_Method method, Transform_Op *ops, int count, M4x4 *m) {
+    PROFILE_SCOPE("set_transforms");
+
+    for (int i = 0; i < count; i++)
+        m[i] = get_op_transform(method, &ops[i]);
+}
+
+static int init_transform(Transform *transform, const char *path, Transform_Method method) {
+    arena_reserve(&transform->arena, transform_arena_size(path));
+
+    if (is_transform_binary(path)) {
+        unsigned long long count;
+        size_t size;
+        Transform_Op *ops = map_transform_binary(path, &count, &size);
+
+        if (!ops)
+            return false;
+
+        transform->size = 1;
+        transform->queue = (M4x4 *)arena_push(&transform->arena, sizeof(M4x4));
+
+        if (!transform->queue) {
+            munmap((Transform_Header *)ops - 1, size);
+            return false;
+        }
+
+        transform->queue[0] = compose_ops(method, ops, count);
+
+        munmap((Transform_Header *)ops - 1, size);
+    } else {
+        int count;
+        Transform_Op *ops;
+
+        if (!read_txt(path, &transform->arena, &ops, &count))
+            return false;
+
+        transform->size = count;
+        transform->queue = (M4x4 *)arena_push(&transform->arena, count * sizeof(M4x4));
+
+        if (!transform->queue)
+            return false;
+
+        set_transforms(method, ops, count, transform->queue);
+    }
+
+    transform->dirty = true;
+    return true;
 }
 
-static void set_transforms(Transform_Method method, Transform_Data *tdata, M4x4 *m) {
-    Rt_Data *rt = tdata->rt;
-    Rf_Data *rf = tdata->rf;
-    Tr_Data *tr = tdata->tr;
-    Sc_Data *sc = tdata->sc;
-    Sh_Data *sh = tdata->sh;
+static void convert_transform(const char *in, const char *out) {
+    Arena arena = {};
+    int count;
+    Transform_Op *ops;
+
+    arena_reserve(&arena, transform_arena_size(in));
+    if (!read_txt(in, &arena, &ops, &count))
+        exit(EXIT_FAILURE);
+
+    write_transform_binary(out, ops, count);
+    fprintf(stdout, "CONVERT: %s -> %s (%d operations)\n", in, out, count);
 
-    for (int i = 0; i < tdata->rt_size; i++)
-        m[rt[i].order] = rotation(method, rt[i].pos, rt[i].normal, rt[i].deg);
-    for (int i = 0; i < tdata->rf_size; i++)
-        m[rf[i].order] = reflection(method, rf[i].plane);
-    for (int i = 0; i < tdata->tr_size; i++)
-        m[tr[i].order] = translate(method, tr[i].translation);
-    for (int i = 0; i < tdata->sc_size; i++)
-        m[sc[i].order] = scale(method, sc[i].pos, sc[i].scale);
-    for (int i = 0; i < tdata->sh_size; i++)
-        m[sh[i].order] = shear(method, sh[i].axis, sh[i].shear);
+    arena_free(&arena);
 }
 
-static void init_transform(Transform *transform, const char *path, Transform_Method method) {
-    Transform_Data tdata = {};
-    read_txt(path, &tdata);
+static void compose_transform(Transform *transform) {
+    if (!transform->dirty)
+        return;
 
-    transform->size = tdata.size;
-    transform->size = tdata.size;
-    transform->queue = (M4x4 *)malloc(transform->size * sizeof(M4x4));
-    transform->queue = (M4x4 *)malloc(transform->size * sizeof(M4x4));
+    PROFILE_SCOPE("compose_transform");
+    glm::mat4 model = glm::mat4(1.0f);
 
-    init_transform_queue(transform);
-    init_transform_queue(transform);
+    for (int i = 0; i < transform->size; i++)
+        model = m4x4_to_mat4(transform->queue[i]) * model;
 
-    set_transforms(method, &tdata, transform->queue);
+    transform->model = model;
 }
 
-static void process_input(Input *input, Camera *cam, float delta_time, GL_Context *context) {
+static void process_input(Input *input, Camera *cam, double delta_time, GL_Context *context) {
     cam->speed = 10.0 * delta_time;
 
+    glm::vec3 last_pos = cam->pos;
+    glm::vec3 last_front = cam->front;
+    int last_width = context->width;
+    int last_height = context->height;
+
     if (glfwGetKey(context->window, GLFW_KEY_F11) == GLFW_RELEASE)
         context->f11_held = false;
 
@@ -161,6 +456,8 @@ static void process_input(Input *input, Camera *cam, float delta_time, GL_Contex
             glfwSetWindowMonitor(context->window, 0, context->windowed_x, context->windowed_y, context->windowed_w, context->windowed_h, GLFW_DONT_CARE);
             context->is_fullscreen = false;
         }
+
+        context->dirty = true;
     }
 
     if (glfwGetKey(context->window, GLFW_KEY_W) == GLFW_PRESS)
@@ -185,11 +482,20 @@ static void process_input(Input *input, Camera *cam, float delta_time, GL_Contex
     if (glfwGetKey(context->window, GLFW_KEY_T) == GLFW_PRESS && !input->t_held) {
         input->should_transform = !input->should_transform;
         input->t_held = true;
+        input->dirty = true;
     }
     if (glfwGetKey(context->window, GLFW_KEY_T) == GLFW_RELEASE) {
         input->t_held = false;
     }
 
+    if (glfwGetMouseButton(context->window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_PRESS && !input->pick_held) {
+        input->should_pick = true;
+        input->pick_held = true;
+    }
+    if (glfwGetMouseButton(context->window, GLFW_MOUSE_BUTTON_LEFT) == GLFW_RELEASE) {
+        input->pick_held = false;
+    }
+
 
     if (cam->mouse_held) {
         double xpos, ypos;
@@ -224,19 +530,25 @@ static void process_input(Input *input, Camera *cam, float delta_time, GL_Contex
     }
 
     glfwGetFramebufferSize(context->window, &context->width, &context->height);
+
+    if (cam->pos != last_pos || cam->front != last_front)
+        cam->dirty = true;
+    if (context->width != last_width || context->height != last_height)
+        context->dirty = true;
 }
 
 static void set_shader_mat4x4(unsigned int shader, const char *value, glm::mat4 matrix) {
-    unsigned int loc = glGetUniformLocation(shader, value);
-    glUniformMatrix4fv(loc, 1, GL_FALSE, glm::value_ptr(matrix));
+    capture_uniform_mat4(shader, value, matrix);
 }
 
 static void set_shader_vec3(unsigned int shader, const char *value, glm::vec3 v) {
-    unsigned int loc = glGetUniformLocation(shader, value);
-    glUniform3f(loc, v.x, v.y, v.z);
+    capture_uniform_vec3(shader, value, v);
 }
 
 static Window_Split get_split_side(GL_Context *context) {
+    if (!context->window)
+        return LEFT;
+
     double xpos, ypos;
     glfwGetCursorPos(context->window, &xpos, &ypos);
 
@@ -249,88 +561,776 @@ static Window_Split get_split_side(GL_Context *context) {
     return result;
 }
 
+static glm::mat4 get_view(Camera *cam) {
+    return glm::lookAt(cam->pos, cam->pos + cam->front, cam->up);
+}
+
+static glm::mat4 get_projection(Camera *cam, GL_Context *context) {
+    return glm::perspective(glm::radians(cam->fov), (float)context->width / (float)context->height, 0.1f, 100.0f);
+}
+
+static glm::mat4 get_model(World *world) {
+    compose_transform(&world->transform);
+    glm::mat4 model = world->transform.model;
+
+    if (!world->input.should_transform)
+        model = glm::inverse(model) * model;
+
+    return model;
+}
+
+static void pick(World *w, Mesh *m, Window_Split side, GL_Context *context) {
+    World *world = &w[side];
+    Mesh *mesh = &m[side];
+
+    double tstart = get_time() * 1000.0;
+
+    double xpos, ypos;
+    glfwGetCursorPos(context->window, &xpos, &ypos);
+
+    float half = context->width / 2.0f;
+    float x = 2.0f * (xpos - side * half) / half - 1.0f;
+    float y = 1.0f - 2.0f * ypos / context->height;
+
+    glm::mat4 inv_view_projection = glm::inverse(get_projection(&world->cam, context) * get_view(&world->cam));
+    glm::mat4 inv_model = glm::inverse(get_model(world));
+
+    glm::vec4 near = inv_view_projection * glm::vec4(x, y, -1.0f, 1.0f);
+    glm::vec4 far  = inv_view_projection * glm::vec4(x, y,  1.0f, 1.0f);
+    near = inv_model * (near / near.w);
+    far  = inv_model * (far / far.w);
+
+    glm::vec3 origin = glm::vec3(near) / near.w;
+    glm::vec3 dir    = glm::vec3(far) / far.w - origin;
+
+    Ray_Hit hit = intersect_bvh(mesh, origin, dir);
+    Selection *selection = &world->selection;
+    selection->active = hit.hit;
+    world->input.dirty = true;
+
+    if (hit.hit) {
+        Index3 f = mesh->index[hit.face];
+        float w1 = 1.0f - hit.u - hit.v;
+
+        selection->face = hit.face;
+        selection->vertex = f.i1;
+        if (hit.u > w1 && hit.u > hit.v) selection->vertex = f.i2;
+        if (hit.v > w1 && hit.v > hit.u) selection->vertex = f.i3;
+    }
+
+    double tend = get_time() * 1000.0;
+
+    if (hit.hit)
+        fprintf(stdout, "PICK: face %d, vertex %d (%fms)\n", selection->face, selection->vertex, tend - tstart);
+    else
+        fprintf(stdout, "PICK: no hit (%fms)\n", tend - tstart);
+}
+
 static void draw_world(World *w, Mesh *m, Window_Split side, GL_Context *context) {
     World *world = &w[side];
     Mesh *mesh = &m[side];
     Camera cam = world->cam;
     Scene scene = world->scene;
-    Input input = world->input;
-    Transform transform = world->transform;
+    Selection selection = world->selection;
+
+    glm::mat4 model      = get_model(world);
+    glm::mat4 view       = get_view(&cam);
+    glm::mat4 projection = get_projection(&cam, context);
+
+    {
+        PROFILE_SCOPE("upload_uniforms");
+        capture_use_program(scene.shader);
+        set_shader_mat4x4(scene.shader, "model", model);
+        set_shader_mat4x4(scene.shader, "view", view);
+        set_shader_mat4x4(scene.shader, "projection", projection);
+        set_shader_vec3(scene.shader, "view_pos", cam.pos);
+        set_shader_vec3(scene.shader, "light_color", scene.light_color);
+        set_shader_vec3(scene.shader, "light_pos", scene.light_pos);
+        set_shader_vec3(scene.shader, "object_color", scene.object_color);
+    }
 
-    glm::mat4 model      = glm::mat4(1.0f);
-    glm::mat4 view       = glm::lookAt(cam.pos, cam.pos + cam.front, cam.up);
-    glm::mat4 projection = glm::perspective(glm::radians(45.0f), (float)context->width / (float)context->height, 0.1f, 100.0f);
+    capture_viewport(side * context->width / 2, 0, context->width / 2, context->height);
+    capture_scissor(side * context->width / 2, 0, context->width / 2, context->height);
+    capture_clear_color(scene.clear);
+    capture_clear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
 
-    for (int i = 0; i < transform.size; i++)
-        model = m4x4_to_mat4(transform.queue[i]) * model;
+    Mesh_Lod *lod = &mesh->lod[select_lod(mesh, model, &cam, context->height)];
 
-    Window_Split current_side = get_split_side(context);
+    {
+        PROFILE_SCOPE("draw");
+        capture_bind_vertex_array(mesh->vao);
+        capture_draw_elements(GL_TRIANGLES, 3 * lod->num_faces, GL_UNSIGNED_INT, lod->offset * sizeof(Index3));
+    }
 
-    if (!input.should_transform)
-        model = glm::inverse(model) * model;
+    if (selection.active) {
+        capture_enable(GL_DEPTH_TEST, false);
+        set_shader_vec3(scene.shader, "object_color", glm::vec3(1.0f) - scene.object_color);
+        capture_draw_elements(GL_TRIANGLES, 3, GL_UNSIGNED_INT, selection.face * sizeof(Index3));
+        capture_point_size(8.0f);
+        capture_draw_arrays(GL_POINTS, selection.vertex, 1);
+        capture_enable(GL_DEPTH_TEST, true);
+    }
+}
+
+static int is_dirty(World *world, GL_Context *context) {
+    int result = context->dirty;
+
+    for (int i = 0; i < 2; i++)
+        result |= world[i].cam.dirty | world[i].input.dirty | world[i].transform.dirty;
+
+    return result;
+}
+
+static void clear_dirty(World *world, GL_Context *context) {
+    context->dirty = false;
+
+    for (int i = 0; i < 2; i++) {
+        world[i].cam.dirty = false;
+        world[i].input.dirty = false;
+        world[i].transform.dirty = false;
+    }
+}
+
+static void write_ppm(const char *path, int width, int height) {
+    unsigned char *pixels = (unsigned char *)malloc(3 * width * height);
+
+    glPixelStorei(GL_PACK_ALIGNMENT, 1);
+    glReadPixels(0, 0, width, height, GL_RGB, GL_UNSIGNED_BYTE, pixels);
+
+    FILE *fptr = fopen(path, "wb");
+
+    if (!fptr) {
+        fprintf(stderr, "ERROR: %s file failed to open!\n", path);
+        free(pixels);
+        return;
+    }
+
+    fprintf(fptr, "P6\n%d %d\n255\n", width, height);
+    for (int y = height - 1; y >= 0; y--)
+        fwrite(pixels + 3 * y * width, 1, 3 * width, fptr);
+
+    fclose(fptr);
+    free(pixels);
+}
+
+static void set_camera_path(World *world, Mesh *mesh, int frame, int frames) {
+    float angle = 2.0f * M_PI * frame / frames;
+    float distance = mesh->radius * (3.0f + 12.0f * (0.5f + 0.5f * sinf(angle)));
+    glm::vec3 target = glm::vec3(get_model(world) * glm::vec4(mesh->center, 1.0f));
+
+    world->cam.pos = target + distance * glm::normalize(glm::vec3(sinf(angle), 0.25f, cosf(angle)));
+    world->cam.front = glm::normalize(target - world->cam.pos);
+    world->cam.dirty = true;
+}
+
+static double read_query_ms(unsigned int query) {
+    GLuint64 ns = 0;
+    glGetQueryObjectui64v(query, GL_QUERY_RESULT, &ns);
+    return ns / 1000000.0;
+}
+
+static void write_timings(const char *label, const char *name, double *cpu_ms, double *gpu_ms, int frames, Options *options) {
+    FILE *fptr = options->timings_path ? fopen(options->timings_path, "w") : stdout;
+
+    if (!fptr) {
+        fprintf(stderr, "ERROR: %s file failed to open!\n", options->timings_path);
+        exit(EXIT_FAILURE);
+    }
+
+    double cpu_total = 0.0, gpu_total = 0.0, cpu_max = 0.0, gpu_max = 0.0;
+
+    fprintf(fptr, "frame,cpu_ms,gpu_ms\n");
+    for (int frame = 0; frame < frames; frame++) {
+        fprintf(fptr, "%d,%f,%f\n", frame, cpu_ms[frame], gpu_ms[frame]);
+
+        cpu_total += cpu_ms[frame];
+        gpu_total += gpu_ms[frame];
+        if (cpu_ms[frame] > cpu_max) cpu_max = cpu_ms[frame];
+        if (gpu_ms[frame] > gpu_max) gpu_max = gpu_ms[frame];
+    }
+
+    if (fptr != stdout)
+        fclose(fptr);
+
+    if (frames)
+        fprintf(stdout, "%s %s: %d frames, CPU mean %fms max %fms, GPU mean %fms max %fms\n",
+                label, name, frames, cpu_total / frames, cpu_max, gpu_total / frames, gpu_max);
+}
+
+static void run_headless(World *world, Mesh *mesh, GL_Context *context, Options *options) {
+    int frames = options->frames;
+    double *cpu_ms = (double *)calloc(frames, sizeof(double));
+    double *gpu_ms = (double *)calloc(frames, sizeof(double));
 
-    glUseProgram(scene.shader);
-    set_shader_mat4x4(scene.shader, "model", model);
-    set_shader_mat4x4(scene.shader, "view", view);
-    set_shader_mat4x4(scene.shader, "projection", projection);
-    set_shader_vec3(scene.shader, "view_pos", cam.pos);
-    set_shader_vec3(scene.shader, "light_color", scene.light_color);
-    set_shader_vec3(scene.shader, "light_pos", scene.light_pos);
-    set_shader_vec3(scene.shader, "object_color", scene.object_color);
-
-    glViewport(side * context->width / 2, 0, context->width / 2, context->height);
-    glScissor(side * context->width / 2, 0, context->width / 2, context->height);
-    glClearColor(scene.clear[0], scene.clear[1], scene.clear[2], scene.clear[3]);
+    unsigned int queries[HEADLESS_QUERIES];
+    glGenQueries(HEADLESS_QUERIES, queries);
+
+    glBeginQuery(GL_TIME_ELAPSED, queries[0]);
+    draw_world(world, mesh, LEFT, context);
+    draw_world(world, mesh, RIGHT, context);
+    glEndQuery(GL_TIME_ELAPSED);
+    read_query_ms(queries[0]);
+    capture_frame();
+
+    for (int frame = 0; frame < frames; frame++) {
+        unsigned int query = queries[frame % HEADLESS_QUERIES];
+
+        if (frame >= HEADLESS_QUERIES)
+            gpu_ms[frame - HEADLESS_QUERIES] = read_query_ms(query);
+
+        double tstart = get_time();
+
+        set_camera_path(&world[LEFT], &mesh[LEFT], frame, frames);
+        set_camera_path(&world[RIGHT], &mesh[RIGHT], frame, frames);
+
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        draw_world(world, mesh, LEFT, context);
+        draw_world(world, mesh, RIGHT, context);
+        glEndQuery(GL_TIME_ELAPSED);
+        glFlush();
+        clear_dirty(world, context);
+        capture_frame();
+
+        cpu_ms[frame] = (get_time() - tstart) * 1000.0;
+
+        if (options->dump_dir) {
+            char path[512];
+            snprintf(path, sizeof(path), "%s/frame_%04d.ppm", options->dump_dir, frame);
+            write_ppm(path, context->width, context->height);
+        }
+    }
+
+    for (int frame = frames > HEADLESS_QUERIES ? frames - HEADLESS_QUERIES : 0; frame < frames; frame++)
+        gpu_ms[frame] = read_query_ms(queries[frame % HEADLESS_QUERIES]);
+
+    write_timings("HEADLESS", options->mesh_path, cpu_ms, gpu_ms, frames, options);
+
+    glDeleteQueries(HEADLESS_QUERIES, queries);
+    free(cpu_ms);
+    free(gpu_ms);
+}
+
+static void run_replay(Trace *trace, GL_Context *context, Options *options) {
+    static Replay replay = {};
+    int capacity = 256, frames = 0;
+    double *cpu_ms = (double *)malloc(capacity * sizeof(double));
+    double *gpu_ms = (double *)malloc(capacity * sizeof(double));
+
+    unsigned int queries[HEADLESS_QUERIES];
+    glGenQueries(HEADLESS_QUERIES, queries);
+
+    glBeginQuery(GL_TIME_ELAPSED, queries[0]);
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
-    glBindVertexArray(mesh->vao);
-    glDrawElements(GL_TRIANGLES, 3 * mesh->num_faces, GL_UNSIGNED_INT, 0);
+    glEndQuery(GL_TIME_ELAPSED);
+    read_query_ms(queries[0]);
+
+    double tstart = get_time();
+
+    while (trace->cursor < trace->size) {
+        if (frames == capacity) {
+            capacity *= 2;
+            cpu_ms = (double *)realloc(cpu_ms, capacity * sizeof(double));
+            gpu_ms = (double *)realloc(gpu_ms, capacity * sizeof(double));
+        }
+
+        unsigned int query = queries[frames % HEADLESS_QUERIES];
+
+        if (frames >= HEADLESS_QUERIES)
+            gpu_ms[frames - HEADLESS_QUERIES] = read_query_ms(query);
+
+        double tframe = get_time();
+
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        replay_frame(trace, &replay);
+        glEndQuery(GL_TIME_ELAPSED);
+        glFlush();
+
+        cpu_ms[frames] = (get_time() - tframe) * 1000.0;
+
+        if (options->dump_dir) {
+            char path[512];
+            snprintf(path, sizeof(path), "%s/frame_%04d.ppm", options->dump_dir, frames);
+            write_ppm(path, context->width, context->height);
+        }
+
+        frames++;
+    }
+
+    for (int frame = frames > HEADLESS_QUERIES ? frames - HEADLESS_QUERIES : 0; frame < frames; frame++)
+        gpu_ms[frame] = read_query_ms(queries[frame % HEADLESS_QUERIES]);
+
+    glFinish();
+    double seconds = get_time() - tstart;
+
+    write_timings("REPLAY", trace->path, cpu_ms, gpu_ms, frames, options);
+    fprintf(stdout, "REPLAY %s: %.1f frames/s\n", trace->path, frames / seconds);
+
+    glDeleteQueries(HEADLESS_QUERIES, queries);
+    free(cpu_ms);
+    free(gpu_ms);
+}
+
+// Runs at a frame boundary on the thread that owns the GL context. Transforms
+// and meshes were parsed by the reload thread and only need swapping in; a new
+// shader is linked across as many frames as the driver needs.
+static void apply_reload(Reload *reload, World *world, Mesh *mesh, GL_Context *context) {
+    int ready = __atomic_load_n(&reload->ready, __ATOMIC_ACQUIRE);
+
+    if (ready & RELOAD_TRANSFORM) {
+        for (int i = 0; i < 2; i++) {
+            arena_free(&world[i].transform.arena);
+            world[i].transform = reload->transform[i];
+        }
+
+        __atomic_fetch_and(&reload->ready, ~RELOAD_TRANSFORM, __ATOMIC_RELEASE);
+    }
+
+    if (ready & RELOAD_MESH) {
+        for (int i = 0; i < 2; i++) {
+            upload_mesh(&reload->mesh[i]);
+            free_mesh(&mesh[i]);
+            mesh[i] = reload->mesh[i];
+            world[i].selection.active = false;
+        }
+
+        context->dirty = true;
+        __atomic_fetch_and(&reload->ready, ~RELOAD_MESH, __ATOMIC_RELEASE);
+    }
+
+    if ((ready & RELOAD_SHADER) && !reload->program)
+        reload->program = begin_program(reload->shader.vertex, reload->shader.fragment);
+
+    if (reload->program && is_program_ready(reload->program)) {
+        unsigned int pid = reload->program;
+        int is_linked;
+        glGetProgramiv(pid, GL_LINK_STATUS, &is_linked);
+
+        if (is_linked) {
+            unsigned int old[2] = { world[LEFT].scene.shader, world[RIGHT].scene.shader };
+            world[LEFT].scene.shader = pid;
+            world[RIGHT].scene.shader = pid;
+
+            glDeleteProgram(old[0]);
+            if (old[1] != old[0])
+                glDeleteProgram(old[1]);
+
+            capture_program(pid, reload->shader.vertex, reload->shader.fragment);
+            context->dirty = true;
+            fprintf(stdout, "RELOAD: shader linked\n");
+        } else {
+            char log[256];
+            glGetProgramInfoLog(pid, sizeof(log), 0, log);
+            fprintf(stderr, "ERROR: Shader reload failed, keeping the previous program!\n %s\n", log);
+            glDeleteProgram(pid);
+        }
+
+        free(reload->shader.vertex);
+        free(reload->shader.fragment);
+        reload->program = 0;
+        __atomic_fetch_and(&reload->ready, ~RELOAD_SHADER, __ATOMIC_RELEASE);
+    }
+}
+
+static void set_raster_draw(Raster_Draw *draw, World *w, Mesh *m, Window_Split side, GL_Context *context) {
+    World *world = &w[side];
+
+    draw->mesh         = &m[side];
+    draw->num_faces    = m[side].lod[0].num_faces;
+    draw->model        = get_model(world);
+    draw->view         = get_view(&world->cam);
+    draw->projection   = get_projection(&world->cam, context);
+    draw->view_pos     = world->cam.pos;
+    draw->light_color  = world->scene.light_color;
+    draw->light_pos    = world->scene.light_pos;
+    draw->object_color = world->scene.object_color;
+    draw->clear        = world->scene.clear;
+
+    draw->x      = side * context->width / 2;
+    draw->y      = 0;
+    draw->width  = context->width / 2;
+    draw->height = context->height;
+}
+
+static double time_software(Rasterizer *raster, Raster_Draw *draws, int threads) {
+    double best = INFINITY;
+    double vertex_ms = 0.0, bin_ms = 0.0, raster_ms = 0.0;
+
+    for (int i = 0; i < SOFTWARE_REPEATS; i++) {
+        double tstart = get_time();
+        raster_draw(raster, draws, 2, threads);
+        double ms = 1000.0 * (get_time() - tstart);
+
+        if (ms < best) {
+            best = ms;
+            vertex_ms = raster->vertex_ms;
+            bin_ms = raster->bin_ms;
+            raster_ms = raster->raster_ms;
+        }
+    }
+
+    int triangles = draws[LEFT].num_faces + draws[RIGHT].num_faces;
+    fprintf(stdout, "SOFTWARE: %d threads, %d triangles, %fms (vertex %fms, bin %fms, raster %fms), %.2f Mtri/s\n",
+            raster->num_threads, triangles, best, vertex_ms, bin_ms, raster_ms, triangles / (1000.0 * best));
+
+    return best;
+}
+
+static void run_software(World *world, Mesh *mesh, Options *options) {
+    GL_Context context = {};
+    context.width = HEADLESS_WIDTH;
+    context.height = HEADLESS_HEIGHT;
+
+    Raster_Draw draws[2];
+    set_raster_draw(&draws[LEFT], world, mesh, LEFT, &context);
+    set_raster_draw(&draws[RIGHT], world, mesh, RIGHT, &context);
+
+    Rasterizer raster = {};
+    raster_init(&raster, context.width, context.height);
+
+    int max_threads = get_num_threads();
+
+    if (options->software_scaling) {
+        double base = 0.0;
+
+        for (int threads = 1; ; threads *= 2) {
+            if (threads > max_threads)
+                threads = max_threads;
+
+            double ms = time_software(&raster, draws, threads);
+            if (threads == 1)
+                base = ms;
+            fprintf(stdout, "SOFTWARE SCALING: %d threads, speedup %.2fx\n", threads, base / ms);
+
+            if (threads == max_threads)
+                break;
+        }
+    } else {
+        time_software(&raster, draws, options->software_threads > 0 ? options->software_threads : max_threads);
+    }
+
+    write_image(options->software_path, raster.color, raster.width, raster.height);
+    raster_free(&raster);
+}
+
+static void publish_snapshot(Triple_Buffer *buffer, World *world, GL_Context *context) {
+    Frame_Snapshot *snapshot = triple_buffer_back(buffer);
+
+    for (int i = 0; i < 2; i++) {
+        compose_transform(&world[i].transform);
+        snapshot->world[i] = world[i];
+        snapshot->world[i].transform.dirty = false;
+    }
+
+    snapshot->width = context->width;
+    snapshot->height = context->height;
+
+    triple_buffer_publish(buffer);
+}
+
+static void *render_entry(void *arg) {
+    Render_Thread *render = (Render_Thread *)arg;
+    Options *options = render->options;
+    glfwMakeContextCurrent(render->window);
+
+    GL_Context context = {};
+    context.window = render->window;
+
+    double frame_interval = options->fps_cap > 0.0f ? 1.0 / options->fps_cap : 0.0;
+    double last_render = 0.0;
+    double last_report = get_time();
+    Frame_Stats stats = {};
+    int has_frame = false;
+    int pending = false;
+
+    while (__atomic_load_n(&render->running, __ATOMIC_ACQUIRE)) {
+        int is_new = triple_buffer_consume(&render->buffer);
+        has_frame = has_frame || is_new;
+        pending = pending || is_new;
+
+        double wait = last_render + frame_interval - get_time();
+
+        if (!has_frame || (options->on_demand && !pending)) {
+            triple_buffer_wait(&render->buffer, &render->running);
+            continue;
+        }
+
+        if (wait > 0.0) {
+            usleep((useconds_t)(1000000.0 * wait));
+            continue;
+        }
+
+        Frame_Snapshot *snapshot = triple_buffer_front(&render->buffer);
+        context.width = snapshot->width;
+        context.height = snapshot->height;
+
+        PROFILE_GPU_BEGIN(LEFT);
+        draw_world(snapshot->world, render->mesh, LEFT, &context);
+        PROFILE_GPU_END(LEFT);
+
+        PROFILE_GPU_BEGIN(RIGHT);
+        draw_world(snapshot->world, render->mesh, RIGHT, &context);
+        PROFILE_GPU_END(RIGHT);
+
+        glfwSwapBuffers(render->window);
+        capture_frame();
+        pending = false;
+
+        double current_frame = get_time();
+        if (last_render > 0.0)
+            frame_stats_add(&stats, current_frame - last_render);
+        last_render = current_frame;
+
+        if (current_frame - last_report >= REPORT_INTERVAL) {
+            frame_stats_report(&stats, "RENDER");
+            last_report = current_frame;
+        }
+    }
+
+    glfwMakeContextCurrent(0);
+    return 0;
+}
+
+static void run_threaded(World *world, Mesh *mesh, GL_Context *context, Options *options, Reload *reload) {
+    static Render_Thread render = {};
+    render.window = context->window;
+    render.mesh = mesh;
+    render.options = options;
+    render.running = true;
+
+    triple_buffer_init(&render.buffer);
+    publish_snapshot(&render.buffer, world, context);
+    clear_dirty(world, context);
+
+    glfwMakeContextCurrent(0);
+
+    pthread_t thread;
+    pthread_create(&thread, 0, render_entry, &render);
+
+    double last_frame = get_time();
+    double last_report = last_frame;
+    Frame_Stats stats = {};
+
+    while (!glfwWindowShouldClose(context->window)) {
+        double current_frame = get_time();
+        double delta_time = current_frame - last_frame;
+        last_frame = current_frame;
+
+        apply_reload(reload, world, mesh, context);
+
+        Window_Split side = get_split_side(context);
+        process_input(&world[side].input, &world[side].cam, delta_time, context);
+
+        if (world[side].input.should_pick) {
+            pick(world, mesh, side, context);
+            world[side].input.should_pick = false;
+        }
+
+        int changed = is_dirty(world, context);
+
+        if (changed) {
+            publish_snapshot(&render.buffer, world, context);
+            clear_dirty(world, context);
+        }
+
+        frame_stats_add(&stats, get_time() - current_frame);
+
+        if (current_frame - last_report >= REPORT_INTERVAL) {
+            frame_stats_report(&stats, "UPDATE");
+            PROFILE_REPORT();
+            last_report = current_frame;
+        }
+
+        if (options->on_demand && !changed && !reload->program) {
+            glfwWaitEventsTimeout(REPORT_INTERVAL);
+            last_frame = get_time();
+        } else {
+            glfwWaitEventsTimeout(UPDATE_INTERVAL);
+        }
+    }
+
+    __atomic_store_n(&render.running, false, __ATOMIC_RELEASE);
+    triple_buffer_wake(&render.buffer);
+    pthread_join(thread, 0);
+
+    glfwMakeContextCurrent(context->window);
 }
 
 int main(int argc, char **argv) {
     GL_Context context = {};
     Mesh mesh[2] = {};
     World world[2] = {};
+    Options options = {};
 
-    init_glcontext(&context, "Transformer", 3, 3);
+    parse_options(&options, argc, argv);
 
-    init_mesh_buffer("off/38.off", &mesh[LEFT]);
-    init_mesh_buffer("off/38.off", &mesh[RIGHT]);
+    if (options.convert_path[0]) {
+        convert_transform(options.convert_path[0], options.convert_path[1]);
+        return 0;
+    }
+
+    if (options.replay_path) {
+        Trace trace = {};
+        open_trace(options.replay_path, &trace);
+        init_glcontext_headless(&context, trace.width, trace.height, 3, 3);
+        run_replay(&trace, &context, &options);
+        PROFILE_EXPORT(options.trace_path);
+        return 0;
+    }
+
+    if (options.software_path) {
+        if (!load_mesh(options.mesh_path, &mesh[LEFT], &options))
+            exit(EXIT_FAILURE);
+
+        copy_mesh(&mesh[RIGHT], &mesh[LEFT]);
+    } else {
+        if (options.headless)
+            init_glcontext_headless(&context, HEADLESS_WIDTH, HEADLESS_HEIGHT, 3, 3);
+        else
+            init_glcontext(&context, "Transformer", 3, 3);
+
+        capture_begin(options.capture_path, context.width, context.height);
+
+        init_mesh_buffers(options.mesh_path, mesh, &options);
+    }
 
     init_camera(&world[LEFT].cam);
     init_camera(&world[RIGHT].cam);
 
-    float tstart, tend;
+    double tstart, tend;
 
-    tstart = glfwGetTime() * 1000.0f;
-    init_transform(&world[LEFT].transform, "transforms/transformations2.txt", GL);
-    tend = glfwGetTime() * 1000.0f;
+    tstart = get_time() * 1000.0;
+    if (!init_transform(&world[LEFT].transform, options.transform_path, GL))
+        exit(EXIT_FAILURE);
+    tend = get_time() * 1000.0;
     fprintf(stdout, "OPENGL TRANSFORM TIME: %fms\n", tend - tstart);
 
-    tstart = glfwGetTime() * 1000.0f;
-    init_transform(&world[RIGHT].transform, "transforms/transformations2.txt", CUSTOM);
-    tend = glfwGetTime() * 1000.0f;
+    tstart = get_time() * 1000.0;
+    if (!init_transform(&world[RIGHT].transform, options.transform_path, CUSTOM))
+        exit(EXIT_FAILURE);
+    tend = get_time() * 1000.0;
     fprintf(stdout, "CUSTOM TRANSFORM TIME: %fms\n", tend - tstart);
 
-    init_scene(&world[LEFT].scene, "basic.glsl", {1.0f, 1.0f, 1.0f}, {5.0f, 5.0f, 50.0f}, {1.0f, 0.5f, 0.0f}, {0.6f, 0.6f, 0.9f, 1.0f});
-    init_scene(&world[RIGHT].scene, "basic.glsl", {1.0f, 1.0f, 1.0f}, {5.0f, 5.0f, 50.0f}, {0.5f, 1.0f, 0.0f}, {0.5f, 0.5f, 0.8f, 1.0f});
+    const char *shader_path = options.software_path ? 0 : "basic.glsl";
+    init_scene(&world[LEFT].scene, shader_path, {1.0f, 1.0f, 1.0f}, {5.0f, 5.0f, 50.0f}, {1.0f, 0.5f, 0.0f}, {0.6f, 0.6f, 0.9f, 1.0f});
+    init_scene(&world[RIGHT].scene, shader_path, {1.0f, 1.0f, 1.0f}, {5.0f, 5.0f, 50.0f}, {0.5f, 1.0f, 0.0f}, {0.5f, 0.5f, 0.8f, 1.0f});
 
-    float last_frame = 0.0f;
-    float delta_time = 0.0f;
+    if (options.software_path) {
+        run_software(world, mesh, &options);
+        PROFILE_REPORT();
+        PROFILE_EXPORT(options.trace_path);
+        return 0;
+    }
+
+    if (options.headless) {
+        run_headless(world, mesh, &context, &options);
+        PROFILE_REPORT();
+        capture_end();
+        PROFILE_EXPORT(options.trace_path);
+        return 0;
+    }
+
+    static Reload reload = {};
+
+    if (options.watch) {
+        if (GLEW_KHR_parallel_shader_compile)
+            glMaxShaderCompilerThreadsKHR(0xFFFFFFFF);
+
+        int kinds = RELOAD_TRANSFORM;
+        if (!options.threaded)
+            kinds |= RELOAD_SHADER | RELOAD_MESH;
+
+        reload_start(&reload, &options, "basic.glsl", kinds);
+    }
+
+    if (options.threaded) {
+        run_threaded(world, mesh, &context, &options, &reload);
+        reload_stop(&reload);
+        capture_end();
+        PROFILE_EXPORT(options.trace_path);
+        return 0;
+    }
+
+    double last_frame = 0.0;
+    double delta_time = 0.0;
+
+    double frame_interval = options.fps_cap > 0.0f ? 1.0 / options.fps_cap : 0.0;
+    double last_render = 0.0;
+    double last_report = get_time();
+    clock_t last_cpu = clock();
+    int frames = 0;
+    int redraw = true;
+    Frame_Stats stats = {};
 
     while (!glfwWindowShouldClose(context.window)) {
-        float current_frame = glfwGetTime();
+        double current_frame = get_time();
         delta_time = current_frame - last_frame;
         last_frame = current_frame;
 
+        apply_reload(&reload, world, mesh, &context);
+
         Window_Split side = get_split_side(&context);
         process_input(&world[side].input, &world[side].cam, delta_time, &context);
 
-        draw_world(world, mesh, LEFT, &context);
-        draw_world(world, mesh, RIGHT, &context);
+        if (world[side].input.should_pick) {
+            pick(world, mesh, side, &context);
+            world[side].input.should_pick = false;
+        }
+
+        int changed = is_dirty(world, &context);
+        redraw = redraw || changed || !options.on_demand;
+
+        if (redraw && current_frame >= last_render + frame_interval) {
+            PROFILE_GPU_BEGIN(LEFT);
+            draw_world(world, mesh, LEFT, &context);
+            PROFILE_GPU_END(LEFT);
+
+            PROFILE_GPU_BEGIN(RIGHT);
+            draw_world(world, mesh, RIGHT, &context);
+            PROFILE_GPU_END(RIGHT);
+
+            glfwSwapBuffers(context.window);
+            capture_frame();
+            clear_dirty(world, &context);
+
+            if (last_render > 0.0)
+                frame_stats_add(&stats, current_frame - last_render);
+
+            redraw = false;
+            last_render = current_frame;
+            frames++;
+        }
+
+        if (current_frame - last_report >= REPORT_INTERVAL) {
+            clock_t cpu = clock();
+            double cpu_time = (double)(cpu - last_cpu) / CLOCKS_PER_SEC;
+
+            if (options.on_demand)
+                fprintf(stdout, "ON DEMAND: %d frames in %.1fs, CPU %.1f%%\n",
+                        frames, current_frame - last_report, 100.0 * cpu_time / (current_frame - last_report));
+
+            frame_stats_report(&stats, "FRAME");
+            PROFILE_REPORT();
+
+            last_report = current_frame;
+            last_cpu = cpu;
+            frames = 0;
+        }
+
+        double wait = last_render + frame_interval - get_time();
 
-        glfwSwapBuffers(context.window);
-        glfwPollEvents();
+        if (redraw && wait > 0.0) {
+            glfwWaitEventsTimeout(wait);
+        } else if (options.on_demand && !redraw && !changed && !reload.program) {
+            glfwWaitEventsTimeout(REPORT_INTERVAL);
+            last_frame = get_time();
+        } else {
+            glfwPollEvents();
+        }
     }
 
+    reload_stop(&reload);
+    capture_end();
+    PROFILE_EXPORT(options.trace_path);
+
     return 0;
 }
@@ -1,32 +1,57 @@
 #if !defined(HEADER_MAIN_H)
 #define HEADER_MAIN_H
 
-#include <assert.h>
-#include <stdio.h>
-#include <stdlib.h>
-#include <string.h>
-#include <math.h>
+#include "common.h"
 
 #include <GL/glew.h>
 #include <GLFW/glfw3.h>
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
 
-#include <glm/glm.hpp>
-#include <glm/gtc/matrix_transform.hpp>
-#include <glm/gtx/transform2.hpp>
-#include <glm/gtc/type_ptr.hpp>
+#define REPORT_INTERVAL 5.0
+#define UPDATE_INTERVAL (1.0 / 240.0)
 
-#include "matrix.h"
+#define HEADLESS_WIDTH  1280
+#define HEADLESS_HEIGHT 720
+#define HEADLESS_QUERIES 4
 
-typedef enum {
-    GL,
-    CUSTOM
-} Transform_Method;
+#define SOFTWARE_REPEATS 5
 
 typedef enum {
     LEFT,
     RIGHT
 } Window_Split;
 
+typedef struct {
+    int weld;
+    float weld_epsilon;
+
+    int on_demand;
+    float fps_cap;
+
+    int headless;
+    int frames;
+    const char *dump_dir;
+    const char *timings_path;
+    const char *mesh_path;
+
+    const char *trace_path;
+
+    const char *transform_path;
+    const char *convert_path[2];
+
+    int threaded;
+
+    const char *software_path;
+    int software_threads;
+    int software_scaling;
+
+    const char *capture_path;
+    const char *replay_path;
+
+    int watch;
+} Options;
+
 typedef struct {
     int width, height;
     GLFWwindow *window;
@@ -35,10 +60,18 @@ typedef struct {
     int windowed_w, windowed_h;
     int windowed_x, windowed_y;
     GLFWmonitor *monitor;
+
+    int dirty;
+
+    EGLDisplay display;
+    EGLContext egl;
+    unsigned int fbo, color, depth;
 } GL_Context;
 
 typedef struct {
     int should_transform, t_held;
+    int should_pick, pick_held;
+    int dirty;
 } Input;
 
 typedef struct {
@@ -49,11 +82,18 @@ typedef struct {
     float lastx, lasty;
     float yaw, pitch;
     float fov;
+
+    int dirty;
 } Camera;
 
 typedef struct {
     int size;
     M4x4 *queue;
+
+    glm::mat4 model;
+    int dirty;
+
+    Arena arena;
 } Transform;
 
 typedef struct {
@@ -64,11 +104,17 @@ typedef struct {
     glm::vec4 clear;
 } Scene;
 
+typedef struct {
+    int active;
+    int face, vertex;
+} Selection;
+
 typedef struct {
     Camera cam;
     Scene scene;
     Input input;
     Transform transform;
+    Selection selection;
 } World;
 
 #endif
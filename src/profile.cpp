@@ -0,0 +1,162 @@
+#if !defined(HEADER_PROFILE_CPP)
+#define HEADER_PROFILE_CPP
+
+#if defined(ENABLE_PROFILE)
+
+#define PROFILE_EVENTS 65536
+#define PROFILE_NAMES  64
+
+// seq is the event index plus one once the fields are written, and zero while
+// a writer owns the slot, so readers can skip events that are not published.
+typedef struct {
+    const char *name;
+    double start, duration;
+    int thread;
+    unsigned long long seq;
+} Profile_Event;
+
+typedef struct {
+    Profile_Event events[PROFILE_EVENTS];
+    unsigned long long count;
+    unsigned long long reported;
+    int num_threads;
+} Profiler;
+
+typedef struct {
+    const char *name;
+    int calls;
+    double total, max;
+} Profile_Summary;
+
+static Profiler profiler;
+static __thread int profile_thread;
+
+static int get_profile_thread(void) {
+    if (!profile_thread)
+        profile_thread = __atomic_add_fetch(&profiler.num_threads, 1, __ATOMIC_RELAXED);
+    return profile_thread;
+}
+
+static void profile_record(const char *name, double start, double duration, int thread) {
+    unsigned long long index = __atomic_fetch_add(&profiler.count, 1, __ATOMIC_RELAXED);
+    Profile_Event *event = &profiler.events[index % PROFILE_EVENTS];
+
+    __atomic_store_n(&event->seq, 0, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+
+    event->name = name;
+    event->start = start;
+    event->duration = duration;
+    event->thread = thread;
+
+    __atomic_store_n(&event->seq, index + 1, __ATOMIC_RELEASE);
+}
+
+// Copies event i out of the ring, failing if it is still being written or
+// was overwritten by a later event while it was copied.
+static int profile_read(unsigned long long i, Profile_Event *out) {
+    Profile_Event *event = &profiler.events[i % PROFILE_EVENTS];
+
+    if (__atomic_load_n(&event->seq, __ATOMIC_ACQUIRE) != i + 1)
+        return false;
+
+    *out = *event;
+    __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+    return __atomic_load_n(&event->seq, __ATOMIC_RELAXED) == i + 1;
+}
+
+struct Profile_Scope {
+    const char *name;
+    double start;
+
+    Profile_Scope(const char *name) : name(name), start(get_time()) {}
+    ~Profile_Scope() { profile_record(name, start, get_time() - start, get_profile_thread()); }
+};
+
+static void profile_report(void) {
+    Profile_Summary summary[PROFILE_NAMES];
+    int num_names = 0;
+
+    unsigned long long count = __atomic_load_n(&profiler.count, __ATOMIC_ACQUIRE);
+    unsigned long long begin = profiler.reported;
+
+    if (count - begin > PROFILE_EVENTS)
+        begin = count - PROFILE_EVENTS;
+
+    for (unsigned long long i = begin; i < count; i++) {
+        Profile_Event event;
+
+        if (!profile_read(i, &event))
+            continue;
+
+        int n = 0;
+        while (n < num_names && strcmp(summary[n].name, event.name))
+            n++;
+
+        if (n == num_names) {
+            if (num_names == PROFILE_NAMES)
+                continue;
+            summary[num_names++] = { event.name, 0, 0.0, 0.0 };
+        }
+
+        summary[n].calls++;
+        summary[n].total += event.duration;
+        if (event.duration > summary[n].max)
+            summary[n].max = event.duration;
+    }
+
+    for (int i = 0; i < num_names; i++)
+        fprintf(stdout, "PROFILE %-20s %6d calls, avg %fms, max %fms\n", summary[i].name, summary[i].calls,
+                1000.0 * summary[i].total / summary[i].calls, 1000.0 * summary[i].max);
+
+    profiler.reported = count;
+}
+
+static void profile_export(const char *path) {
+    if (!path)
+        return;
+
+    FILE *fptr = fopen(path, "w");
+
+    if (!fptr) {
+        fprintf(stderr, "ERROR: %s file failed to open!\n", path);
+        return;
+    }
+
+    unsigned long long count = __atomic_load_n(&profiler.count, __ATOMIC_ACQUIRE);
+    unsigned long long begin = count > PROFILE_EVENTS ? count - PROFILE_EVENTS : 0;
+
+    fprintf(fptr, "{\"traceEvents\":[\n");
+    fprintf(fptr, "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":0,\"args\":{\"name\":\"GPU\"}}");
+
+    for (unsigned long long i = begin; i < count; i++) {
+        Profile_Event event;
+
+        if (!profile_read(i, &event))
+            continue;
+
+        fprintf(fptr, ",\n{\"name\":\"%s\",\"ph\":\"X\",\"pid\":1,\"tid\":%d,\"ts\":%.3f,\"dur\":%.3f}",
+                event.name, event.thread, 1000000.0 * event.start, 1000000.0 * event.duration);
+    }
+
+    fprintf(fptr, "\n]}\n");
+    fclose(fptr);
+}
+
+#define PROFILE_CONCAT_(a, b) a##b
+#define PROFILE_CONCAT(a, b)  PROFILE_CONCAT_(a, b)
+
+#define PROFILE_SCOPE(name)   Profile_Scope PROFILE_CONCAT(profile_scope_, __LINE__)(name)
+#define PROFILE_REPORT()      profile_report()
+#define PROFILE_EXPORT(path)  profile_export(path)
+
+#else
+
+#define PROFILE_SCOPE(name)
+#define PROFILE_REPORT()
+#define PROFILE_EXPORT(path)
+
+#endif
+
+#endif
@@ -0,0 +1,50 @@
+#if !defined(HEADER_PROFILE_GL_CPP)
+#define HEADER_PROFILE_GL_CPP
+
+#if defined(ENABLE_PROFILE)
+
+#define PROFILE_GPU_QUERIES 4
+
+typedef struct {
+    const char *name;
+    unsigned int queries[PROFILE_GPU_QUERIES];
+    double start[PROFILE_GPU_QUERIES];
+    int pending[PROFILE_GPU_QUERIES];
+    int current;
+} Gpu_Timer;
+
+static Gpu_Timer gpu_timers[2] = { { "draw_left_gpu" }, { "draw_right_gpu" } };
+
+static void gpu_timer_begin(Gpu_Timer *timer) {
+    if (!timer->queries[0])
+        glGenQueries(PROFILE_GPU_QUERIES, timer->queries);
+
+    int slot = timer->current % PROFILE_GPU_QUERIES;
+
+    if (timer->pending[slot]) {
+        GLuint64 ns = 0;
+        glGetQueryObjectui64v(timer->queries[slot], GL_QUERY_RESULT, &ns);
+        profile_record(timer->name, timer->start[slot], ns / 1000000000.0, 0);
+    }
+
+    timer->start[slot] = get_time();
+    glBeginQuery(GL_TIME_ELAPSED, timer->queries[slot]);
+}
+
+static void gpu_timer_end(Gpu_Timer *timer) {
+    glEndQuery(GL_TIME_ELAPSED);
+    timer->pending[timer->current % PROFILE_GPU_QUERIES] = true;
+    timer->current++;
+}
+
+#define PROFILE_GPU_BEGIN(side) gpu_timer_begin(&gpu_timers[side])
+#define PROFILE_GPU_END(side)   gpu_timer_end(&gpu_timers[side])
+
+#else
+
+#define PROFILE_GPU_BEGIN(side)
+#define PROFILE_GPU_END(side)
+
+#endif
+
+#endif
@@ -0,0 +1,616 @@
+#if !defined(HEADER_RASTER_CPP)
+#define HEADER_RASTER_CPP
+
+#if defined(__SSE2__)
+#include <xmmintrin.h>
+#include <emmintrin.h>
+#endif
+
+#define RASTER_TILE      64
+#define RASTER_MAX_DRAWS 2
+#define RASTER_NEAR_W    1e-5f
+
+typedef struct {
+    const Mesh *mesh;
+    int num_faces;
+
+    glm::mat4 model, view, projection;
+    glm::vec3 view_pos;
+    glm::vec3 light_color;
+    glm::vec3 light_pos;
+    glm::vec3 object_color;
+    glm::vec4 clear;
+
+    int x, y, width, height;
+} Raster_Draw;
+
+typedef struct {
+    glm::vec3 pos, normal;
+    float sx, sy, z, inv_w;
+    int clipped;
+} Raster_Vertex;
+
+typedef struct {
+    int next, end;
+    char pad[56];
+} Raster_Queue;
+
+typedef struct {
+    int width, height;
+    int tiles_x, tiles_y, num_tiles;
+    unsigned char *color;
+
+    Raster_Draw *draws;
+    int num_draws;
+    int vertex_base[RASTER_MAX_DRAWS];
+    int face_base[RASTER_MAX_DRAWS + 1];
+
+    Raster_Vertex *vertex;
+    int vertex_capacity;
+
+    int *tile_count, *tile_offset;
+    int *bins;
+    int bin_capacity;
+
+    Raster_Queue *queues;
+    int num_threads;
+
+    double vertex_ms, bin_ms, raster_ms;
+} Rasterizer;
+
+static void raster_init(Rasterizer *r, int width, int height) {
+    r->width = width;
+    r->height = height;
+    r->tiles_x = (width + RASTER_TILE - 1) / RASTER_TILE;
+    r->tiles_y = (height + RASTER_TILE - 1) / RASTER_TILE;
+    r->num_tiles = r->tiles_x * r->tiles_y;
+
+    r->color = (unsigned char *)malloc(3 * width * height);
+    r->tile_count = (int *)malloc(r->num_tiles * sizeof(int));
+    r->tile_offset = (int *)malloc((r->num_tiles + 1) * sizeof(int));
+    r->queues = (Raster_Queue *)malloc(MAX_THREADS * sizeof(Raster_Queue));
+}
+
+static void raster_free(Rasterizer *r) {
+    free(r->color);
+    free(r->tile_count);
+    free(r->tile_offset);
+    free(r->queues);
+    free(r->vertex);
+    free(r->bins);
+    *r = {};
+}
+
+static void get_worker_range(int count, int worker, int num_workers, int *begin, int *end) {
+    *begin = (int)((long long)count * worker / num_workers);
+    *end   = (int)((long long)count * (worker + 1) / num_workers);
+}
+
+static void get_face(Rasterizer *r, int tri, int *draw, Raster_Vertex **v) {
+    int d = 0;
+    while (tri >= r->face_base[d + 1])
+        d++;
+
+    Index3 f = r->draws[d].mesh->index[tri - r->face_base[d]];
+    Raster_Vertex *vertex = r->vertex + r->vertex_base[d];
+
+    *draw = d;
+    v[0] = &vertex[f.i1];
+    v[1] = &vertex[f.i2];
+    v[2] = &vertex[f.i3];
+}
+
+static void transform_vertex_range(void *data, int begin, int end) {
+    Rasterizer *r = (Rasterizer *)data;
+
+    for (int worker = begin; worker < end; worker++) {
+        for (int d = 0; d < r->num_draws; d++) {
+            Raster_Draw *draw = &r->draws[d];
+            const Mesh *mesh = draw->mesh;
+            Raster_Vertex *out = r->vertex + r->vertex_base[d];
+
+            glm::mat4 view_projection = draw->projection * draw->view;
+            glm::mat3 normal_matrix = glm::transpose(glm::inverse(glm::mat3(draw->model)));
+
+            int first, last;
+            get_worker_range(mesh->num_vertex, worker, r->num_threads, &first, &last);
+
+            for (int i = first; i < last; i++) {
+                glm::vec4 pos = draw->model * glm::vec4(mesh->vertex[i].v, 1.0f);
+                glm::vec4 clip = view_projection * pos;
+                Raster_Vertex *v = &out[i];
+
+                v->pos = glm::vec3(pos);
+                v->normal = normal_matrix * mesh->vertex[i].n;
+                v->clipped = clip.w <= RASTER_NEAR_W;
+
+                if (v->clipped)
+                    continue;
+
+                v->inv_w = 1.0f / clip.w;
+                v->sx = draw->x + (0.5f + 0.5f * clip.x * v->inv_w) * draw->width;
+                v->sy = draw->y + (0.5f - 0.5f * clip.y * v->inv_w) * draw->height;
+                v->z  = 0.5f + 0.5f * clip.z * v->inv_w;
+            }
+        }
+    }
+}
+
+// Triangles crossing the near plane are dropped instead of clipped, and
+// bounds are in tiles, clamped to the draw's viewport.
+static int get_tile_bounds(Rasterizer *r, int tri, int *tx0, int *ty0, int *tx1, int *ty1) {
+    Raster_Vertex *v[3];
+    int d;
+    get_face(r, tri, &d, v);
+
+    if (v[0]->clipped || v[1]->clipped || v[2]->clipped)
+        return false;
+
+    if (v[0]->z > 1.0f && v[1]->z > 1.0f && v[2]->z > 1.0f)
+        return false;
+
+    Raster_Draw *draw = &r->draws[d];
+    float minx = fmaxf(fminf(v[0]->sx, fminf(v[1]->sx, v[2]->sx)), (float)draw->x);
+    float miny = fmaxf(fminf(v[0]->sy, fminf(v[1]->sy, v[2]->sy)), (float)draw->y);
+    float maxx = fminf(fmaxf(v[0]->sx, fmaxf(v[1]->sx, v[2]->sx)), (float)(draw->x + draw->width - 1));
+    float maxy = fminf(fmaxf(v[0]->sy, fmaxf(v[1]->sy, v[2]->sy)), (float)(draw->y + draw->height - 1));
+
+    if (minx > maxx || miny > maxy)
+        return false;
+
+    *tx0 = (int)minx / RASTER_TILE;
+    *ty0 = (int)miny / RASTER_TILE;
+    *tx1 = (int)maxx / RASTER_TILE;
+    *ty1 = (int)maxy / RASTER_TILE;
+    return true;
+}
+
+static void count_bin_range(void *data, int begin, int end) {
+    Rasterizer *r = (Rasterizer *)data;
+    int num_faces = r->face_base[r->num_draws];
+
+    for (int worker = begin; worker < end; worker++) {
+        int first, last;
+        get_worker_range(num_faces, worker, r->num_threads, &first, &last);
+
+        for (int tri = first; tri < last; tri++) {
+            int tx0, ty0, tx1, ty1;
+            if (!get_tile_bounds(r, tri, &tx0, &ty0, &tx1, &ty1))
+                continue;
+
+            for (int ty = ty0; ty <= ty1; ty++) {
+                for (int tx = tx0; tx <= tx1; tx++)
+                    __atomic_fetch_add(&r->tile_count[ty * r->tiles_x + tx], 1, __ATOMIC_RELAXED);
+            }
+        }
+    }
+}
+
+static void fill_bin_range(void *data, int begin, int end) {
+    Rasterizer *r = (Rasterizer *)data;
+    int num_faces = r->face_base[r->num_draws];
+
+    for (int worker = begin; worker < end; worker++) {
+        int first, last;
+        get_worker_range(num_faces, worker, r->num_threads, &first, &last);
+
+        for (int tri = first; tri < last; tri++) {
+            int tx0, ty0, tx1, ty1;
+            if (!get_tile_bounds(r, tri, &tx0, &ty0, &tx1, &ty1))
+                continue;
+
+            for (int ty = ty0; ty <= ty1; ty++) {
+                for (int tx = tx0; tx <= tx1; tx++) {
+                    int slot = __atomic_fetch_add(&r->tile_count[ty * r->tiles_x + tx], 1, __ATOMIC_RELAXED);
+                    r->bins[slot] = tri;
+                }
+            }
+        }
+    }
+}
+
+// Rasterizes into a visibility buffer of depth, triangle id and screen-space
+// barycentrics, four pixels per step with SSE2 and one at a time otherwise.
+// Equal depths resolve to the lower id, so the image doesn't depend on the
+// order triangles were binned in.
+static void raster_tile_triangle(Rasterizer *r, int tri, int x0, int y0,
+                                 float *depth, int *id, float *b1, float *b2) {
+    Raster_Vertex *v[3];
+    int d;
+    get_face(r, tri, &d, v);
+
+    Raster_Draw *draw = &r->draws[d];
+
+    float area = (v[1]->sx - v[0]->sx) * (v[2]->sy - v[0]->sy) - (v[2]->sx - v[0]->sx) * (v[1]->sy - v[0]->sy);
+    if (area == 0.0f)
+        return;
+
+    float sign = area > 0.0f ? 1.0f : -1.0f;
+    float inv_area = 1.0f / area;
+
+    float a[3], b[3], c[3];
+    for (int i = 0; i < 3; i++) {
+        Raster_Vertex *p = v[(i + 1) % 3];
+        Raster_Vertex *q = v[(i + 2) % 3];
+        a[i] = -(q->sy - p->sy) * sign;
+        b[i] =  (q->sx - p->sx) * sign;
+        c[i] = ((q->sy - p->sy) * p->sx - (q->sx - p->sx) * p->sy) * sign;
+    }
+
+    float min_x = fmaxf((float)x0, (float)draw->x);
+    float min_y = fmaxf((float)y0, (float)draw->y);
+    float max_x = fminf((float)(x0 + RASTER_TILE - 1), (float)(draw->x + draw->width - 1));
+    float max_y = fminf((float)(y0 + RASTER_TILE - 1), (float)(draw->y + draw->height - 1));
+
+    int px0 = (int)fmaxf(fminf(v[0]->sx, fminf(v[1]->sx, v[2]->sx)), min_x);
+    int py0 = (int)fmaxf(fminf(v[0]->sy, fminf(v[1]->sy, v[2]->sy)), min_y);
+    int px1 = (int)fminf(fmaxf(v[0]->sx, fmaxf(v[1]->sx, v[2]->sx)), max_x);
+    int py1 = (int)fminf(fmaxf(v[0]->sy, fmaxf(v[1]->sy, v[2]->sy)), max_y);
+
+#if defined(__SSE2__)
+    __m128 offset = _mm_set_ps(3.5f, 2.5f, 1.5f, 0.5f);
+    __m128 zero = _mm_setzero_ps();
+    __m128 first_x = _mm_set1_ps(px0 + 0.5f);
+    __m128 last_x = _mm_set1_ps(px1 + 0.5f);
+
+    px0 &= ~3;
+    __m128 inv = _mm_set1_ps(inv_area * sign);
+    __m128 z0 = _mm_set1_ps(v[0]->z);
+    __m128 dz1 = _mm_set1_ps(v[1]->z - v[0]->z);
+    __m128 dz2 = _mm_set1_ps(v[2]->z - v[0]->z);
+    __m128i tri_id = _mm_set1_epi32(tri);
+
+    __m128 a0 = _mm_set1_ps(a[0]), a1 = _mm_set1_ps(a[1]), a2 = _mm_set1_ps(a[2]);
+
+    for (int y = py0; y <= py1; y++) {
+        float fy = y + 0.5f;
+        __m128 row0 = _mm_set1_ps(b[0] * fy + c[0]);
+        __m128 row1 = _mm_set1_ps(b[1] * fy + c[1]);
+        __m128 row2 = _mm_set1_ps(b[2] * fy + c[2]);
+
+        for (int x = px0; x <= px1; x += 4) {
+            __m128 fx = _mm_add_ps(_mm_set1_ps((float)x), offset);
+            __m128 w0 = _mm_add_ps(_mm_mul_ps(a0, fx), row0);
+            __m128 w1 = _mm_add_ps(_mm_mul_ps(a1, fx), row1);
+            __m128 w2 = _mm_add_ps(_mm_mul_ps(a2, fx), row2);
+
+            __m128 mask = _mm_and_ps(_mm_and_ps(_mm_cmpge_ps(w0, zero), _mm_cmpge_ps(w1, zero)),
+                                     _mm_and_ps(_mm_cmpge_ps(w2, zero), _mm_cmpge_ps(fx, first_x)));
+            mask = _mm_and_ps(mask, _mm_cmple_ps(fx, last_x));
+            if (!_mm_movemask_ps(mask))
+                continue;
+
+            __m128 l1 = _mm_mul_ps(w1, inv);
+            __m128 l2 = _mm_mul_ps(w2, inv);
+            __m128 z = _mm_add_ps(z0, _mm_add_ps(_mm_mul_ps(l1, dz1), _mm_mul_ps(l2, dz2)));
+
+            int index = (y - y0) * RASTER_TILE + (x - x0);
+            __m128 old_z = _mm_load_ps(depth + index);
+            __m128i old_id = _mm_load_si128((__m128i *)(id + index));
+
+            __m128 tie = _mm_and_ps(_mm_cmpeq_ps(z, old_z), _mm_castsi128_ps(_mm_cmplt_epi32(tri_id, old_id)));
+            mask = _mm_and_ps(mask, _mm_cmpge_ps(z, zero));
+            mask = _mm_and_ps(mask, _mm_or_ps(_mm_cmplt_ps(z, old_z), tie));
+
+            if (!_mm_movemask_ps(mask))
+                continue;
+
+            _mm_store_ps(depth + index, _mm_or_ps(_mm_and_ps(mask, z), _mm_andnot_ps(mask, old_z)));
+            _mm_store_ps(b1 + index, _mm_or_ps(_mm_and_ps(mask, l1), _mm_andnot_ps(mask, _mm_load_ps(b1 + index))));
+            _mm_store_ps(b2 + index, _mm_or_ps(_mm_and_ps(mask, l2), _mm_andnot_ps(mask, _mm_load_ps(b2 + index))));
+
+            __m128i imask = _mm_castps_si128(mask);
+            _mm_store_si128((__m128i *)(id + index),
+                            _mm_or_si128(_mm_and_si128(imask, tri_id), _mm_andnot_si128(imask, old_id)));
+        }
+    }
+#else
+    float inv = inv_area * sign;
+    float dz1 = v[1]->z - v[0]->z;
+    float dz2 = v[2]->z - v[0]->z;
+
+    for (int y = py0; y <= py1; y++) {
+        float fy = y + 0.5f;
+        float row0 = b[0] * fy + c[0];
+        float row1 = b[1] * fy + c[1];
+        float row2 = b[2] * fy + c[2];
+
+        for (int x = px0; x <= px1; x++) {
+            float fx = x + 0.5f;
+            float w0 = a[0] * fx + row0;
+            float w1 = a[1] * fx + row1;
+            float w2 = a[2] * fx + row2;
+
+            if (!(w0 >= 0.0f && w1 >= 0.0f && w2 >= 0.0f))
+                continue;
+
+            float l1 = w1 * inv;
+            float l2 = w2 * inv;
+            float z = v[0]->z + (l1 * dz1 + l2 * dz2);
+
+            int index = (y - y0) * RASTER_TILE + (x - x0);
+            if (!(z >= 0.0f) || !(z < depth[index] || (z == depth[index] && tri < id[index])))
+                continue;
+
+            depth[index] = z;
+            b1[index] = l1;
+            b2[index] = l2;
+            id[index] = tri;
+        }
+    }
+#endif
+}
+
+// Same lighting as the fragment stage of basic.glsl.
+static glm::vec3 shade_phong(Raster_Draw *draw, glm::vec3 pos, glm::vec3 normal) {
+    glm::vec3 ambient = 0.1f * draw->light_color;
+
+    glm::vec3 norm = glm::normalize(normal);
+    glm::vec3 light_dir = glm::normalize(draw->light_pos - pos);
+    float diff = fmaxf(glm::dot(norm, light_dir), 0.0f);
+    glm::vec3 diffuse = diff * draw->light_color;
+
+    glm::vec3 view_dir = glm::normalize(draw->view_pos - pos);
+    glm::vec3 reflect_dir = -light_dir - 2.0f * glm::dot(norm, -light_dir) * norm;
+    float spec = powf(fmaxf(glm::dot(view_dir, reflect_dir), 0.0f), 32.0f);
+    glm::vec3 specular = 2.5f * spec * draw->light_color;
+
+    return (ambient + diffuse + specular) * draw->object_color;
+}
+
+static unsigned char to_byte(float value) {
+    return (unsigned char)(fminf(fmaxf(value, 0.0f), 1.0f) * 255.0f + 0.5f);
+}
+
+static void shade_tile(Rasterizer *r, int x0, int y0, int *id, float *b1, float *b2) {
+    int x1 = x0 + RASTER_TILE < r->width  ? x0 + RASTER_TILE : r->width;
+    int y1 = y0 + RASTER_TILE < r->height ? y0 + RASTER_TILE : r->height;
+
+    for (int y = y0; y < y1; y++) {
+        for (int x = x0; x < x1; x++) {
+            int index = (y - y0) * RASTER_TILE + (x - x0);
+            unsigned char *out = r->color + 3 * (y * r->width + x);
+            glm::vec3 color = glm::vec3(0.0f);
+
+            if (id[index] < 0) {
+                for (int d = 0; d < r->num_draws; d++) {
+                    Raster_Draw *draw = &r->draws[d];
+                    if (x >= draw->x && x < draw->x + draw->width && y >= draw->y && y < draw->y + draw->height)
+                        color = glm::vec3(draw->clear);
+                }
+            } else {
+                Raster_Vertex *v[3];
+                int d;
+                get_face(r, id[index], &d, v);
+
+                float w0 = (1.0f - b1[index] - b2[index]) * v[0]->inv_w;
+                float w1 = b1[index] * v[1]->inv_w;
+                float w2 = b2[index] * v[2]->inv_w;
+                float inv_sum = 1.0f / (w0 + w1 + w2);
+                w0 *= inv_sum;
+                w1 *= inv_sum;
+                w2 *= inv_sum;
+
+                glm::vec3 pos = w0 * v[0]->pos + w1 * v[1]->pos + w2 * v[2]->pos;
+                glm::vec3 normal = w0 * v[0]->normal + w1 * v[1]->normal + w2 * v[2]->normal;
+                color = shade_phong(&r->draws[d], pos, normal);
+            }
+
+            out[0] = to_byte(color.x);
+            out[1] = to_byte(color.y);
+            out[2] = to_byte(color.z);
+        }
+    }
+}
+
+static void raster_tile(Rasterizer *r, int tile) {
+    alignas(16) float depth[RASTER_TILE * RASTER_TILE];
+    alignas(16) int id[RASTER_TILE * RASTER_TILE];
+    alignas(16) float b1[RASTER_TILE * RASTER_TILE];
+    alignas(16) float b2[RASTER_TILE * RASTER_TILE];
+
+    for (int i = 0; i < RASTER_TILE * RASTER_TILE; i++) {
+        depth[i] = 1.0f;
+        id[i] = -1;
+        b1[i] = b2[i] = 0.0f;
+    }
+
+    int x0 = (tile % r->tiles_x) * RASTER_TILE;
+    int y0 = (tile / r->tiles_x) * RASTER_TILE;
+
+    for (int i = r->tile_offset[tile]; i < r->tile_offset[tile + 1]; i++)
+        raster_tile_triangle(r, r->bins[i], x0, y0, depth, id, b1, b2);
+
+    shade_tile(r, x0, y0, id, b1, b2);
+}
+
+// Each worker drains its own contiguous run of tiles, then steals from the
+// others' runs until every queue is empty.
+static void raster_worker_range(void *data, int begin, int end) {
+    Rasterizer *r = (Rasterizer *)data;
+
+    for (int worker = begin; worker < end; worker++) {
+        for (int i = 0; i < r->num_threads; i++) {
+            Raster_Queue *queue = &r->queues[(worker + i) % r->num_threads];
+
+            for (;;) {
+                int tile = __atomic_fetch_add(&queue->next, 1, __ATOMIC_RELAXED);
+                if (tile >= queue->end)
+                    break;
+                raster_tile(r, tile);
+            }
+        }
+    }
+}
+
+static void raster_draw(Rasterizer *r, Raster_Draw *draws, int num_draws, int num_threads) {
+    PROFILE_SCOPE("raster_draw");
+
+    r->draws = draws;
+    r->num_draws = num_draws < RASTER_MAX_DRAWS ? num_draws : RASTER_MAX_DRAWS;
+    r->num_threads = num_threads < 1 ? 1 : num_threads < MAX_THREADS ? num_threads : MAX_THREADS;
+
+    int num_vertex = 0;
+    r->face_base[0] = 0;
+
+    for (int d = 0; d < r->num_draws; d++) {
+        r->vertex_base[d] = num_vertex;
+        r->face_base[d + 1] = r->face_base[d] + draws[d].num_faces;
+        num_vertex += draws[d].mesh->num_vertex;
+    }
+
+    if (num_vertex > r->vertex_capacity) {
+        r->vertex = (Raster_Vertex *)realloc(r->vertex, num_vertex * sizeof(Raster_Vertex));
+        r->vertex_capacity = num_vertex;
+    }
+
+    double tstart = get_time();
+    parallel_for_threads(r->num_threads, r->num_threads, 1, transform_vertex_range, r);
+    double tvertex = get_time();
+
+    memset(r->tile_count, 0, r->num_tiles * sizeof(int));
+    parallel_for_threads(r->num_threads, r->num_threads, 1, count_bin_range, r);
+
+    r->tile_offset[0] = 0;
+    for (int i = 0; i < r->num_tiles; i++) {
+        r->tile_offset[i + 1] = r->tile_offset[i] + r->tile_count[i];
+        r->tile_count[i] = r->tile_offset[i];
+    }
+
+    if (r->tile_offset[r->num_tiles] > r->bin_capacity) {
+        r->bin_capacity = r->tile_offset[r->num_tiles];
+        r->bins = (int *)realloc(r->bins, r->bin_capacity * sizeof(int));
+    }
+
+    parallel_for_threads(r->num_threads, r->num_threads, 1, fill_bin_range, r);
+    double tbin = get_time();
+
+    for (int i = 0; i < r->num_threads; i++)
+        get_worker_range(r->num_tiles, i, r->num_threads, &r->queues[i].next, &r->queues[i].end);
+
+    parallel_for_threads(r->num_threads, r->num_threads, 1, raster_worker_range, r);
+    double tend = get_time();
+
+    r->vertex_ms = 1000.0 * (tvertex - tstart);
+    r->bin_ms = 1000.0 * (tbin - tvertex);
+    r->raster_ms = 1000.0 * (tend - tbin);
+}
+
+static unsigned int crc32_update(unsigned int crc, const unsigned char *data, size_t size) {
+    static unsigned int table[256];
+
+    if (!table[1]) {
+        for (unsigned int i = 0; i < 256; i++) {
+            unsigned int c = i;
+            for (int k = 0; k < 8; k++)
+                c = c & 1 ? 0xEDB88320u ^ (c >> 1) : c >> 1;
+            table[i] = c;
+        }
+    }
+
+    for (size_t i = 0; i < size; i++)
+        crc = table[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+
+    return crc;
+}
+
+static void write_be32(unsigned char *out, unsigned int value) {
+    out[0] = value >> 24;
+    out[1] = value >> 16;
+    out[2] = value >> 8;
+    out[3] = value;
+}
+
+static void write_png_chunk(FILE *fptr, const char *type, const unsigned char *data, unsigned int size) {
+    unsigned char header[8];
+    write_be32(header, size);
+    memcpy(header + 4, type, 4);
+
+    unsigned int crc = crc32_update(0xFFFFFFFFu, header + 4, 4);
+    crc = crc32_update(crc, data, size) ^ 0xFFFFFFFFu;
+
+    unsigned char footer[4];
+    write_be32(footer, crc);
+
+    fwrite(header, 1, 8, fptr);
+    fwrite(data, 1, size, fptr);
+    fwrite(footer, 1, 4, fptr);
+}
+
+// Writes stored (uncompressed) deflate blocks, which keeps the encoder small
+// at the cost of file size.
+static void write_png(FILE *fptr, const unsigned char *rgb, int width, int height) {
+    size_t row = 3 * width + 1;
+    size_t raw_size = row * height;
+    size_t num_blocks = (raw_size + 65534) / 65535;
+    size_t size = 2 + raw_size + 5 * num_blocks + 4;
+
+    unsigned char *data = (unsigned char *)malloc(size);
+    unsigned char *raw = (unsigned char *)malloc(raw_size);
+
+    for (int y = 0; y < height; y++) {
+        raw[y * row] = 0;
+        memcpy(raw + y * row + 1, rgb + 3 * y * width, 3 * width);
+    }
+
+    unsigned char *out = data;
+    *out++ = 0x78;
+    *out++ = 0x01;
+
+    unsigned int s1 = 1, s2 = 0;
+    for (size_t i = 0; i < raw_size; i++) {
+        s1 = (s1 + raw[i]) % 65521;
+        s2 = (s2 + s1) % 65521;
+    }
+
+    for (size_t i = 0; i < raw_size; i += 65535) {
+        unsigned int len = raw_size - i < 65535 ? raw_size - i : 65535;
+        *out++ = i + len == raw_size;
+        *out++ = len & 0xFF;
+        *out++ = len >> 8;
+        *out++ = ~len & 0xFF;
+        *out++ = (~len >> 8) & 0xFF;
+        memcpy(out, raw + i, len);
+        out += len;
+    }
+
+    write_be32(out, (s2 << 16) | s1);
+
+    unsigned char ihdr[13];
+    write_be32(ihdr, width);
+    write_be32(ihdr + 4, height);
+    ihdr[8] = 8;
+    ihdr[9] = 2;
+    ihdr[10] = ihdr[11] = ihdr[12] = 0;
+
+    static const unsigned char signature[8] = { 0x89, 'P', 'N', 'G', '\r', '\n', 0x1A, '\n' };
+    fwrite(signature, 1, 8, fptr);
+    write_png_chunk(fptr, "IHDR", ihdr, sizeof(ihdr));
+    write_png_chunk(fptr, "IDAT", data, size);
+    write_png_chunk(fptr, "IEND", 0, 0);
+
+    free(raw);
+    free(data);
+}
+
+static void write_image(const char *path, const unsigned char *rgb, int width, int height) {
+    FILE *fptr = fopen(path, "wb");
+
+    if (!fptr) {
+        fprintf(stderr, "ERROR: %s file failed to open!\n", path);
+        return;
+    }
+
+    size_t len = strlen(path);
+
+    if (len > 4 && !strcmp(path + len - 4, ".png")) {
+        write_png(fptr, rgb, width, height);
+    } else {
+        fprintf(fptr, "P6\n%d %d\n255\n", width, height);
+        fwrite(rgb, 1, 3 * width * height, fptr);
+    }
+
+    fclose(fptr);
+}
+
+#endif
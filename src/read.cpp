@@ -1,57 +1,81 @@
 #if !defined(HEADER_READ_CPP)
 #define HEADER_READ_CPP
 
+typedef enum {
+    TRANSLATION,
+    ROTATION,
+    SCALING,
+    REFLECTION,
+    SHEARING
+} Transform_Type;
+
+/*
+ * One operation of a transform sequence, laid out identically in memory and
+ * in the binary transform format. Parameters by type:
+ *   TRANSLATION  f[0..2] translation
+ *   ROTATION     f[0..2] position, f[3..5] axis, f[6] degrees
+ *   SCALING      f[0..2] position, f[3..5] scale
+ *   REFLECTION   f[0..3] plane
+ *   SHEARING     axis, f[0] shear
+ */
 typedef struct {
-    int order;
-    float deg;
-    glm::vec3 pos, normal;
-} Rt_Data;
+    unsigned short type;
+    char axis;
+    char reserved;
+    float f[7];
+} Transform_Op;
+
+// Shortest text an operation can take: its header line ("#Shearing\n").
+#define TRANSFORM_MIN_TEXT 10
 
 typedef struct {
-    int order;
-    glm::vec4 plane;
-} Rf_Data;
+    char magic[4];
+    unsigned int version;
+    unsigned long long count;
+} Transform_Header;
 
 typedef struct {
-    int order;
-    glm::vec3 translation;
-} Tr_Data;
+    unsigned int i1, i2, i3;
+} Index3;
 
 typedef struct {
-    int order;
-    glm::vec3 pos, scale;
-} Sc_Data;
+    glm::vec3 v, n;
+} Vertex3;
+
+#define MAX_LOD 6
 
 typedef struct {
-    int order;
-    char axis;
-    float shear;
-} Sh_Data;
+    int offset;
+    int num_faces;
+    float error;
+} Mesh_Lod;
 
 typedef struct {
-    unsigned int i1, i2, i3;
-} Index3;
+    glm::vec3 min, max;
+    int left;
+    int count;
+} Bvh_Node;
 
 typedef struct {
-    glm::vec3 v, n;
-} Vertex3;
+    int num_nodes;
+    Bvh_Node *nodes;
+    int *faces;
+} Bvh;
 
 typedef struct {
     int num_faces;
     int num_vertex;
     Index3  *index;
     Vertex3 *vertex;
-    unsigned int vao;
-} Mesh;
+    unsigned int vao, vbo, ebo;
 
-typedef struct {
-    Rt_Data *rt;
-    Rf_Data *rf;
-    Tr_Data *tr;
-    Sc_Data *sc;
-    Sh_Data *sh;
-    int rt_size, rf_size, tr_size, sc_size, sh_size, size;
-} Transform_Data;
+    int num_lod;
+    Mesh_Lod lod[MAX_LOD];
+    glm::vec3 center;
+    float radius;
+
+    Bvh bvh;
+} Mesh;
 
 typedef struct {
     char *vertex;
@@ -65,138 +89,214 @@ static void strip_str(char *str) {
     }
 }
 
-static void read_off(const char *path, Mesh *mesh) {
+static void compute_normals(Mesh *mesh) {
+    PROFILE_SCOPE("compute_normals");
+
+    for (int i = 0; i < mesh->num_faces; i++) {
+        glm::vec3 p1 = mesh->vertex[mesh->index[i].i1].v;
+        glm::vec3 p2 = mesh->vertex[mesh->index[i].i2].v;
+        glm::vec3 p3 = mesh->vertex[mesh->index[i].i3].v;
+        glm::vec3 n = glm::normalize(glm::cross(p1 - p3, p2 - p3));
+
+        mesh->vertex[mesh->index[i].i1].n = n;
+        mesh->vertex[mesh->index[i].i2].n = n;
+        mesh->vertex[mesh->index[i].i3].n = n;
+    }
+}
+
+static int read_off(const char *path, Mesh *mesh) {
+    PROFILE_SCOPE("read_off");
+
     FILE *fptr = fopen(path, "r");
 
     if (!fptr) {
-        fprintf(stderr, "ERROR: Could not open file!\n");
-        return;
+        fprintf(stderr, "ERROR: Could not open file %s!\n", path);
+        return false;
     }
 
     char buffer[256];
-    fscanf(fptr, "%s\n", buffer);
-
-    if (strcmp(buffer, "OFF"))
-        exit(EXIT_FAILURE);
-
     int num_vertex, num_faces, num_edges;
-    fscanf(fptr, "%d %d %d\n", &num_vertex, &num_faces, &num_edges);
+
+    if (fscanf(fptr, "%255s\n", buffer) != 1 || strcmp(buffer, "OFF") ||
+        fscanf(fptr, "%d %d %d\n", &num_vertex, &num_faces, &num_edges) != 3 ||
+        num_vertex <= 0 || num_faces <= 0) {
+        fprintf(stderr, "ERROR: %s is not a valid OFF file!\n", path);
+        fclose(fptr);
+        return false;
+    }
 
     mesh->num_faces  = num_faces;
     mesh->num_vertex = num_vertex;
     mesh->index      = (Index3  *)malloc(num_faces  * sizeof(*mesh->index));
     mesh->vertex     = (Vertex3 *)malloc(num_vertex * sizeof(*mesh->vertex));
 
-    for (int i = 0; i < num_vertex; i++)
-        fscanf(fptr, "%f %f %f\n",
-               &mesh->vertex[i].v.x, &mesh->vertex[i].v.y, &mesh->vertex[i].v.z);
+    int valid = true;
+
+    for (int i = 0; i < num_vertex && valid; i++)
+        valid = fscanf(fptr, "%f %f %f\n",
+                       &mesh->vertex[i].v.x, &mesh->vertex[i].v.y, &mesh->vertex[i].v.z) == 3;
 
     int dim;
 
-    for (int i = 0; i < num_faces; i++) {
-        fscanf(fptr, "%d %d %d %d\n",
-               &dim, &mesh->index[i].i1, &mesh->index[i].i2, &mesh->index[i].i3);
+    for (int i = 0; i < num_faces && valid; i++) {
+        Index3 *f = &mesh->index[i];
+        valid = fscanf(fptr, "%d %d %d %d\n", &dim, &f->i1, &f->i2, &f->i3) == 4 &&
+                (unsigned)f->i1 < (unsigned)num_vertex &&
+                (unsigned)f->i2 < (unsigned)num_vertex &&
+                (unsigned)f->i3 < (unsigned)num_vertex;
+    }
 
-        glm::vec3 p1 = mesh->vertex[mesh->index[i].i1].v;
-        glm::vec3 p2 = mesh->vertex[mesh->index[i].i2].v;
-        glm::vec3 p3 = mesh->vertex[mesh->index[i].i3].v;
-        glm::vec3 n = glm::normalize(glm::cross(p1 - p3, p2 - p3));
+    fclose(fptr);
 
-        mesh->vertex[mesh->index[i].i1].n = n;
-        mesh->vertex[mesh->index[i].i2].n = n;
-        mesh->vertex[mesh->index[i].i3].n = n;
+    if (!valid) {
+        fprintf(stderr, "ERROR: %s is truncated or has invalid faces!\n", path);
+        free(mesh->index);
+        free(mesh->vertex);
+        *mesh = {};
+        return false;
     }
 
-    fclose(fptr);
+    compute_normals(mesh);
+    return true;
+}
+
+static Transform_Op *push_op(Arena *arena, Transform_Op **first, int *count, Transform_Type type) {
+    Transform_Op *op = (Transform_Op *)arena_push(arena, sizeof(Transform_Op));
+    if (!op)
+        return 0;
+
+    memset(op, 0, sizeof(*op));
+    op->type = type;
+
+    if (!*first)
+        *first = op;
+    (*count)++;
+
+    return op;
 }
 
-static void read_txt(const char *path, Transform_Data *data) {
+static int read_txt(const char *path, Arena *arena, Transform_Op **ops, int *count) {
     FILE *fptr = fopen(path, "r");
 
     if (!fptr) {
         fprintf(stderr, "ERROR: %s file failed to open!\n", path);
-        exit(EXIT_FAILURE);
+        return false;
     }
 
     char buffer[256];
-    int rt_size = 0, rf_size = 0, tr_size = 0, sc_size = 0, sh_size = 0;
+    Transform_Op *result = 0;
+    int valid = true;
+    *count = 0;
 
-    while (fgets(buffer, sizeof(buffer), fptr)) {
+    while (valid && fgets(buffer, sizeof(buffer), fptr)) {
         strip_str(buffer);
-        if (!strcmp(buffer, "#Translation")) tr_size++;
-        if (!strcmp(buffer, "#Rotation"))    rt_size++;
-        if (!strcmp(buffer, "#Scaling"))     sc_size++;
-        if (!strcmp(buffer, "#Reflection"))  rf_size++;
-        if (!strcmp(buffer, "#Shearing"))    sh_size++;
+        if (!strcmp(buffer, "#Translation")) {
+            Transform_Op *op = push_op(arena, &result, count, TRANSLATION);
+            valid = op && fscanf(fptr, "%f %f %f\n", &op->f[0], &op->f[1], &op->f[2]) == 3;
+        } else if (!strcmp(buffer, "#Rotation")) {
+            Transform_Op *op = push_op(arena, &result, count, ROTATION);
+            valid = op && fscanf(fptr, "%f %f %f\n", &op->f[0], &op->f[1], &op->f[2]) == 3 &&
+                          fscanf(fptr, "%f %f %f\n", &op->f[3], &op->f[4], &op->f[5]) == 3 &&
+                          fscanf(fptr, "%f\n", &op->f[6]) == 1;
+        } else if (!strcmp(buffer, "#Scaling")) {
+            Transform_Op *op = push_op(arena, &result, count, SCALING);
+            valid = op && fscanf(fptr, "%f %f %f\n", &op->f[0], &op->f[1], &op->f[2]) == 3 &&
+                          fscanf(fptr, "%f %f %f\n", &op->f[3], &op->f[4], &op->f[5]) == 3;
+        } else if (!strcmp(buffer, "#Reflection")) {
+            Transform_Op *op = push_op(arena, &result, count, REFLECTION);
+            valid = op && fscanf(fptr, "%f %f %f %f\n", &op->f[0], &op->f[1], &op->f[2], &op->f[3]) == 4;
+        } else if (!strcmp(buffer, "#Shearing")) {
+            Transform_Op *op = push_op(arena, &result, count, SHEARING);
+            valid = op && fscanf(fptr, "%c %f\n", &op->axis, &op->f[0]) == 2;
+        }
     }
 
-    rewind(fptr);
+    fclose(fptr);
 
-    data->rt = (Rt_Data *)malloc(rt_size * sizeof(Rt_Data));
-    data->rf = (Rf_Data *)malloc(rf_size * sizeof(Rf_Data));
-    data->tr = (Tr_Data *)malloc(tr_size * sizeof(Tr_Data));
-    data->sc = (Sc_Data *)malloc(sc_size * sizeof(Sc_Data));
-    data->sh = (Sh_Data *)malloc(sh_size * sizeof(Sh_Data));
+    if (!valid) {
+        fprintf(stderr, "ERROR: %s has a truncated or malformed transform!\n", path);
+        return false;
+    }
 
-    data->rt_size = rt_size;
-    data->rf_size = rf_size;
-    data->tr_size = tr_size;
-    data->sc_size = sc_size;
-    data->sh_size = sh_size;
-    data->size = rt_size + rf_size + tr_size + sc_size + sh_size;
+    *ops = result;
+    return true;
+}
 
-    Rt_Data *rt = data->rt;
-    Rf_Data *rf = data->rf;
-    Tr_Data *tr = data->tr;
-    Sc_Data *sc = data->sc;
-    Sh_Data *sh = data->sh;
+static int is_transform_binary(const char *path) {
+    FILE *fptr = fopen(path, "rb");
 
-    int index = 0;
+    if (!fptr)
+        return false;
 
-    while (fgets(buffer, sizeof(buffer), fptr)) {
-        strip_str(buffer);
-        if (!strcmp(buffer, "#Translation")) {
-            glm::vec3 translation;
-            fscanf(fptr, "%f %f %f\n", &translation.x, &translation.y, &translation.z);
-            tr->order = index++;
-            tr->translation = translation;
-            tr++;
-        } else if (!strcmp(buffer, "#Rotation")) {
-            float deg;
-            glm::vec3 pos, normal;
-            fscanf(fptr, "%f %f %f\n", &pos.x, &pos.y, &pos.z);
-            fscanf(fptr, "%f %f %f\n", &normal.x, &normal.y, &normal.z);
-            fscanf(fptr, "%f\n", &deg);
-            rt->order = index++;
-            rt->pos = pos;
-            rt->normal = normal;
-            rt->deg = deg;
-            rt++;
-        } else if (!strcmp(buffer, "#Scaling")) {
-            glm::vec3 pos, scale;
-            fscanf(fptr, "%f %f %f\n", &pos.x, &pos.y, &pos.z);
-            fscanf(fptr, "%f %f %f\n", &scale.x, &scale.y, &scale.z);
-            sc->order = index++;
-            sc->pos = pos;
-            sc->scale = scale;
-            sc++;
-        } else if (!strcmp(buffer, "#Reflection")) {
-            glm::vec4 plane;
-            fscanf(fptr, "%f %f %f %f\n", &plane.x, &plane.y, &plane.z, &plane.w);
-            rf->order = index++;
-            rf->plane = plane;
-            rf++;
-        } else if (!strcmp(buffer, "#Shearing")) {
-            char axis;
-            float shear;
-            fscanf(fptr, "%c %f\n", &axis, &shear);
-            sh->order = index++;
-            sh->axis = axis;
-            sh->shear = shear;
-            sh++;
-        }
+    char magic[4] = {};
+    fread(magic, 1, sizeof(magic), fptr);
+    fclose(fptr);
+
+    return !memcmp(magic, "TFB1", 4);
+}
+
+// Upper bound on the arena a transform file needs. A binary file only keeps
+// its composed matrix; every text op takes at least TRANSFORM_MIN_TEXT bytes
+// of input and becomes one Transform_Op plus one queue matrix.
+static size_t transform_arena_size(const char *path) {
+    struct stat st;
+
+    if (stat(path, &st) || is_transform_binary(path))
+        return sizeof(M4x4);
+
+    size_t ops = st.st_size / TRANSFORM_MIN_TEXT + 1;
+    return ops * (sizeof(Transform_Op) + sizeof(M4x4)) + ARENA_ALIGN;
+}
+
+static Transform_Op *map_transform_binary(const char *path, unsigned long long *count, size_t *size) {
+    int fd = open(path, O_RDONLY);
+
+    if (fd < 0) {
+        fprintf(stderr, "ERROR: %s file failed to open!\n", path);
+        return 0;
     }
 
+    struct stat st;
+    fstat(fd, &st);
+    *size = st.st_size;
+
+    void *data = *size >= sizeof(Transform_Header) ? mmap(0, *size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+    close(fd);
+
+    if (data == MAP_FAILED) {
+        fprintf(stderr, "ERROR: %s could not be mapped!\n", path);
+        return 0;
+    }
+
+    Transform_Header *header = (Transform_Header *)data;
+
+    size_t max_count = (*size - sizeof(Transform_Header)) / sizeof(Transform_Op);
+
+    // Compared as a count so a corrupt header cannot overflow the size product.
+    if (memcmp(header->magic, "TFB1", 4) || header->version != 1 || header->count > max_count ||
+        sizeof(Transform_Header) + header->count * sizeof(Transform_Op) != *size) {
+        fprintf(stderr, "ERROR: %s is not a valid transform file!\n", path);
+        munmap(data, *size);
+        return 0;
+    }
+
+    madvise(data, *size, MADV_SEQUENTIAL);
+
+    *count = header->count;
+    return (Transform_Op *)(header + 1);
+}
+
+static void write_transform_binary(const char *path, Transform_Op *ops, unsigned long long count) {
+    FILE *fptr = fopen(path, "wb");
+
+    if (!fptr) {
+        fprintf(stderr, "ERROR: %s file failed to open!\n", path);
+        exit(EXIT_FAILURE);
+    }
+
+    Transform_Header header = { {'T', 'F', 'B', '1'}, 1, count };
+    fwrite(&header, sizeof(header), 1, fptr);
+    fwrite(ops, sizeof(Transform_Op), count, fptr);
     fclose(fptr);
 }
 
@@ -204,8 +304,8 @@ static Shader_Source parse_glsl(const char *path) {
     FILE *fptr = fopen(path, "rb");
 
     if (!fptr) {
-        fprintf(stderr, "ERROR: Failed to open GLSL file!\n");
-        exit(EXIT_FAILURE);
+        fprintf(stderr, "ERROR: Failed to open GLSL file %s!\n", path);
+        return {};
     }
 
     char buffer[256];
@@ -234,8 +334,9 @@ static Shader_Source parse_glsl(const char *path) {
     }
 
     if (!started) {
-        fprintf(stderr, "ERROR: Incorrect GLSL headers!\n");
-        exit(EXIT_FAILURE);
+        fprintf(stderr, "ERROR: Incorrect GLSL headers in %s!\n", path);
+        fclose(fptr);
+        return {};
     }
 
     if (!fend) fend = ftell(fptr);
@@ -0,0 +1,175 @@
+#if !defined(HEADER_RELOAD_CPP)
+#define HEADER_RELOAD_CPP
+
+#include <poll.h>
+#include <libgen.h>
+#include <sys/inotify.h>
+
+#define RELOAD_TRANSFORM 1
+#define RELOAD_SHADER    2
+#define RELOAD_MESH      4
+
+#define RELOAD_FILES     3
+#define RELOAD_POLL_MS   100
+
+typedef struct {
+    const char *path;
+    char name[256];
+    int kind;
+    int wd;
+} Watch_File;
+
+typedef struct {
+    Options *options;
+    Watch_File files[RELOAD_FILES];
+    int num_files;
+
+    int fd;
+    pthread_t thread;
+    int running;
+
+    int ready;
+    Transform transform[2];
+    Shader_Source shader;
+    Mesh mesh[2];
+    unsigned int program;
+} Reload;
+
+static int init_transform(Transform *transform, const char *path, Transform_Method method);
+static int load_mesh(const char *path, Mesh *mesh, Options *options);
+static void copy_mesh(Mesh *dst, const Mesh *src);
+
+static void add_watch(Reload *reload, const char *path, int kind) {
+    char dir[256];
+    snprintf(dir, sizeof(dir), "%s", path);
+
+    Watch_File *file = &reload->files[reload->num_files];
+    file->path = path;
+    file->kind = kind;
+    file->wd = inotify_add_watch(reload->fd, dirname(dir), IN_CLOSE_WRITE | IN_MOVED_TO);
+    snprintf(file->name, sizeof(file->name), "%s", strrchr(path, '/') ? strrchr(path, '/') + 1 : path);
+
+    if (file->wd < 0) {
+        fprintf(stderr, "ERROR: Could not watch %s!\n", path);
+        return;
+    }
+
+    reload->num_files++;
+}
+
+// Waits until the frame loop has taken the previous result of this kind, so
+// each slot only ever has one writer.
+static int wait_slot(Reload *reload, int kind) {
+    while (__atomic_load_n(&reload->ready, __ATOMIC_ACQUIRE) & kind) {
+        if (!__atomic_load_n(&reload->running, __ATOMIC_ACQUIRE))
+            return false;
+        usleep(1000 * RELOAD_POLL_MS / 10);
+    }
+
+    return true;
+}
+
+static void reload_file(Reload *reload, Watch_File *file) {
+    if (!wait_slot(reload, file->kind))
+        return;
+
+    double tstart = get_time() * 1000.0;
+    int loaded = false;
+
+    // A file caught mid-edit must not take the session down: on a parse error
+    // the partial result is dropped and the frame loop keeps what it has.
+    if (file->kind == RELOAD_TRANSFORM) {
+        reload->transform[LEFT] = {};
+        reload->transform[RIGHT] = {};
+        loaded = init_transform(&reload->transform[LEFT], file->path, GL) &&
+                 init_transform(&reload->transform[RIGHT], file->path, CUSTOM);
+
+        if (!loaded) {
+            arena_free(&reload->transform[LEFT].arena);
+            arena_free(&reload->transform[RIGHT].arena);
+        }
+    } else if (file->kind == RELOAD_SHADER) {
+        reload->shader = parse_glsl(file->path);
+        loaded = reload->shader.vertex != 0;
+    } else if (file->kind == RELOAD_MESH) {
+        reload->mesh[LEFT] = {};
+        reload->mesh[RIGHT] = {};
+        loaded = load_mesh(file->path, &reload->mesh[LEFT], reload->options);
+
+        if (loaded)
+            copy_mesh(&reload->mesh[RIGHT], &reload->mesh[LEFT]);
+    }
+
+    if (!loaded) {
+        fprintf(stderr, "ERROR: Could not reload %s, keeping the previous version!\n", file->path);
+        return;
+    }
+
+    double tend = get_time() * 1000.0;
+    fprintf(stdout, "RELOAD: %s parsed (%fms)\n", file->path, tend - tstart);
+
+    __atomic_fetch_or(&reload->ready, file->kind, __ATOMIC_RELEASE);
+    glfwPostEmptyEvent();
+}
+
+static void *reload_entry(void *arg) {
+    Reload *reload = (Reload *)arg;
+    char buffer[4096] __attribute__((aligned(__alignof__(struct inotify_event))));
+
+    while (__atomic_load_n(&reload->running, __ATOMIC_ACQUIRE)) {
+        struct pollfd pfd = { reload->fd, POLLIN, 0 };
+
+        if (poll(&pfd, 1, RELOAD_POLL_MS) <= 0)
+            continue;
+
+        ssize_t len = read(reload->fd, buffer, sizeof(buffer));
+        int changed = 0;
+
+        for (char *ptr = buffer; ptr < buffer + len; ) {
+            struct inotify_event *event = (struct inotify_event *)ptr;
+
+            for (int i = 0; i < reload->num_files; i++) {
+                Watch_File *file = &reload->files[i];
+                if (event->len && event->wd == file->wd && !strcmp(event->name, file->name))
+                    changed |= 1 << i;
+            }
+
+            ptr += sizeof(struct inotify_event) + event->len;
+        }
+
+        for (int i = 0; i < reload->num_files; i++) {
+            if (changed & (1 << i))
+                reload_file(reload, &reload->files[i]);
+        }
+    }
+
+    return 0;
+}
+
+static void reload_start(Reload *reload, Options *options, const char *shader_path, int kinds) {
+    reload->options = options;
+    reload->fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+
+    if (reload->fd < 0) {
+        fprintf(stderr, "ERROR: inotify is not available, hot reload disabled!\n");
+        return;
+    }
+
+    if (kinds & RELOAD_TRANSFORM) add_watch(reload, options->transform_path, RELOAD_TRANSFORM);
+    if (kinds & RELOAD_SHADER)    add_watch(reload, shader_path, RELOAD_SHADER);
+    if (kinds & RELOAD_MESH)      add_watch(reload, options->mesh_path, RELOAD_MESH);
+
+    reload->running = true;
+    pthread_create(&reload->thread, 0, reload_entry, reload);
+}
+
+static void reload_stop(Reload *reload) {
+    if (!reload->running)
+        return;
+
+    __atomic_store_n(&reload->running, false, __ATOMIC_RELEASE);
+    pthread_join(reload->thread, 0);
+    close(reload->fd);
+}
+
+#endif
@@ -0,0 +1,258 @@
+#if !defined(HEADER_SIMPLIFY_CPP)
+#define HEADER_SIMPLIFY_CPP
+
+#define LOD_MIN_FACES   64
+#define LOD_PIXEL_ERROR 1.0f
+
+typedef struct {
+    double aa, ab, ac, ad;
+    double bb, bc, bd;
+    double cc, cd;
+    double dd;
+} Quadric;
+
+typedef struct {
+    double cost;
+    unsigned int from, to;
+} Collapse;
+
+static void quadric_add(Quadric *q, Quadric *p) {
+    q->aa += p->aa; q->ab += p->ab; q->ac += p->ac; q->ad += p->ad;
+    q->bb += p->bb; q->bc += p->bc; q->bd += p->bd;
+    q->cc += p->cc; q->cd += p->cd;
+    q->dd += p->dd;
+}
+
+static Quadric quadric_from_plane(double a, double b, double c, double d, double w) {
+    Quadric q = {
+        w * a * a, w * a * b, w * a * c, w * a * d,
+        w * b * b, w * b * c, w * b * d,
+        w * c * c, w * c * d,
+        w * d * d
+    };
+    return q;
+}
+
+static double quadric_error(Quadric *q, glm::vec3 v) {
+    double x = v.x, y = v.y, z = v.z;
+    double result = q->aa * x * x + 2.0 * q->ab * x * y + 2.0 * q->ac * x * z + 2.0 * q->ad * x
+                  + q->bb * y * y + 2.0 * q->bc * y * z + 2.0 * q->bd * y
+                  + q->cc * z * z + 2.0 * q->cd * z
+                  + q->dd;
+    return result > 0.0 ? result : 0.0;
+}
+
+static int compare_collapse(const void *a, const void *b) {
+    double ca = ((Collapse *)a)->cost;
+    double cb = ((Collapse *)b)->cost;
+    return (ca > cb) - (ca < cb);
+}
+
+static Quadric *compute_vertex_quadrics(const Mesh *mesh) {
+    Quadric *result = (Quadric *)calloc(mesh->num_vertex, sizeof(Quadric));
+
+    for (int i = 0; i < mesh->num_faces; i++) {
+        Index3 f = mesh->index[i];
+        glm::vec3 p1 = mesh->vertex[f.i1].v;
+        glm::vec3 p2 = mesh->vertex[f.i2].v;
+        glm::vec3 p3 = mesh->vertex[f.i3].v;
+        glm::vec3 n  = glm::cross(p2 - p1, p3 - p1);
+
+        float area = glm::length(n);
+        if (area <= 0.0f)
+            continue;
+
+        n = n / area;
+        Quadric q = quadric_from_plane(n.x, n.y, n.z, -glm::dot(n, p1), 1.0);
+
+        quadric_add(&result[f.i1], &q);
+        quadric_add(&result[f.i2], &q);
+        quadric_add(&result[f.i3], &q);
+    }
+
+    return result;
+}
+
+static void add_collapse(Collapse *c, const Mesh *mesh, Quadric *quadrics, unsigned int a, unsigned int b) {
+    Quadric q = quadrics[a];
+    quadric_add(&q, &quadrics[b]);
+
+    double ea = quadric_error(&q, mesh->vertex[a].v);
+    double eb = quadric_error(&q, mesh->vertex[b].v);
+
+    if (ea < eb) {
+        c->cost = ea;
+        c->from = b;
+        c->to   = a;
+    } else {
+        c->cost = eb;
+        c->from = a;
+        c->to   = b;
+    }
+}
+
+// Collapses edges of faces in place until at most target faces remain and
+// returns the new face count. quadrics and max_error carry over between calls,
+// so each level continues from the previous one instead of the full mesh.
+static int simplify_mesh(const Mesh *mesh, Quadric *quadrics, Index3 *faces, int num_faces, int target, double *max_error) {
+    int num_vertex = mesh->num_vertex;
+
+    unsigned int *remap = (unsigned int *)malloc(num_vertex * sizeof(unsigned int));
+    unsigned char *locked = (unsigned char *)malloc(num_vertex);
+    Collapse *collapses = (Collapse *)malloc(3 * num_faces * sizeof(Collapse));
+
+    for (int i = 0; i < num_vertex; i++)
+        remap[i] = i;
+
+    while (num_faces > target) {
+        int num_collapses = 0;
+
+        for (int i = 0; i < num_faces; i++) {
+            add_collapse(&collapses[num_collapses++], mesh, quadrics, faces[i].i1, faces[i].i2);
+            add_collapse(&collapses[num_collapses++], mesh, quadrics, faces[i].i2, faces[i].i3);
+            add_collapse(&collapses[num_collapses++], mesh, quadrics, faces[i].i3, faces[i].i1);
+        }
+
+        qsort(collapses, num_collapses, sizeof(Collapse), compare_collapse);
+        memset(locked, 0, num_vertex);
+
+        double threshold = collapses[num_collapses / 4].cost;
+        int limit = (num_faces - target) / 2 + 1;
+        int done = 0;
+
+        for (int i = 0; i < num_collapses && done < limit; i++) {
+            Collapse c = collapses[i];
+
+            if (c.cost > threshold && done > 0)
+                break;
+            if (locked[c.from] || locked[c.to])
+                continue;
+
+            remap[c.from] = c.to;
+            quadric_add(&quadrics[c.to], &quadrics[c.from]);
+            locked[c.from] = locked[c.to] = 1;
+
+            if (c.cost > *max_error)
+                *max_error = c.cost;
+            done++;
+        }
+
+        if (!done)
+            break;
+
+        int count = 0;
+
+        for (int i = 0; i < num_faces; i++) {
+            Index3 f = { remap[faces[i].i1], remap[faces[i].i2], remap[faces[i].i3] };
+
+            if (f.i1 == f.i2 || f.i2 == f.i3 || f.i3 == f.i1)
+                continue;
+
+            faces[count++] = f;
+        }
+
+        for (int i = 0; i < num_vertex; i++)
+            remap[i] = i;
+
+        num_faces = count;
+    }
+
+    free(remap);
+    free(locked);
+    free(collapses);
+
+    return num_faces;
+}
+
+static void compute_mesh_bounds(Mesh *mesh) {
+    glm::vec3 min = mesh->vertex[0].v;
+    glm::vec3 max = mesh->vertex[0].v;
+
+    for (int i = 1; i < mesh->num_vertex; i++) {
+        min = glm::min(min, mesh->vertex[i].v);
+        max = glm::max(max, mesh->vertex[i].v);
+    }
+
+    mesh->center = (min + max) * 0.5f;
+    mesh->radius = 0.0f;
+
+    for (int i = 0; i < mesh->num_vertex; i++) {
+        float d = glm::length(mesh->vertex[i].v - mesh->center);
+        if (d > mesh->radius) mesh->radius = d;
+    }
+}
+
+static void build_lods(Mesh *mesh) {
+    PROFILE_SCOPE("build_lods");
+
+    compute_mesh_bounds(mesh);
+
+    mesh->lod[0].offset    = 0;
+    mesh->lod[0].num_faces = mesh->num_faces;
+    mesh->lod[0].error     = 0.0f;
+    mesh->num_lod = 1;
+
+    if (mesh->num_faces / 2 < LOD_MIN_FACES)
+        return;
+
+    Quadric *quadrics = compute_vertex_quadrics(mesh);
+    Index3 *faces = (Index3 *)malloc(mesh->num_faces * sizeof(Index3));
+    memcpy(faces, mesh->index, mesh->num_faces * sizeof(Index3));
+
+    // Each level halves the face count, so all of them fit in twice the base.
+    mesh->index = (Index3 *)realloc(mesh->index, 2 * mesh->num_faces * sizeof(Index3));
+
+    int num_faces = mesh->num_faces;
+    int offset = mesh->num_faces;
+    double max_error = 0.0;
+
+    for (int target = mesh->num_faces / 2; mesh->num_lod < MAX_LOD && target >= LOD_MIN_FACES; target /= 2) {
+        num_faces = simplify_mesh(mesh, quadrics, faces, num_faces, target, &max_error);
+
+        if (num_faces >= mesh->lod[mesh->num_lod - 1].num_faces)
+            break;
+
+        Mesh_Lod *lod = &mesh->lod[mesh->num_lod++];
+        lod->offset    = offset;
+        lod->num_faces = num_faces;
+        lod->error     = sqrt(max_error);
+
+        memcpy(mesh->index + offset, faces, num_faces * sizeof(Index3));
+        offset += num_faces;
+    }
+
+    mesh->index = (Index3 *)realloc(mesh->index, offset * sizeof(Index3));
+
+    free(faces);
+    free(quadrics);
+}
+
+static int get_lod_faces(const Mesh *mesh) {
+    const Mesh_Lod *last = &mesh->lod[mesh->num_lod - 1];
+    return last->offset + last->num_faces;
+}
+
+static int select_lod(Mesh *mesh, glm::mat4 model, Camera *cam, int height) {
+    glm::vec3 center = glm::vec3(model * glm::vec4(mesh->center, 1.0f));
+
+    float scale = glm::length(glm::vec3(model[0]));
+    scale = fmaxf(scale, glm::length(glm::vec3(model[1])));
+    scale = fmaxf(scale, glm::length(glm::vec3(model[2])));
+
+    float distance = glm::length(center - cam->pos) - mesh->radius * scale;
+    if (distance <= 0.0f)
+        return 0;
+
+    float pixels_per_unit = 0.5f * height / (distance * tanf(glm::radians(cam->fov) * 0.5f));
+
+    int result = 0;
+    for (int i = 1; i < mesh->num_lod; i++) {
+        if (mesh->lod[i].error * scale * pixels_per_unit > LOD_PIXEL_ERROR)
+            break;
+        result = i;
+    }
+
+    return result;
+}
+
+#endif
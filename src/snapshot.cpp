@@ -0,0 +1,110 @@
+#if !defined(HEADER_SNAPSHOT_CPP)
+#define HEADER_SNAPSHOT_CPP
+
+#define TRIPLE_NEW 4
+#define TRIPLE_SLOT 3
+
+typedef struct {
+    World world[2];
+    int width, height;
+} Frame_Snapshot;
+
+typedef struct {
+    Frame_Snapshot slots[3];
+    int back, front;
+    int middle;
+
+    pthread_mutex_t lock;
+    pthread_cond_t published;
+} Triple_Buffer;
+
+typedef struct {
+    int count;
+    double total, total2, max;
+} Frame_Stats;
+
+typedef struct {
+    GLFWwindow *window;
+    Mesh *mesh;
+    Options *options;
+
+    Triple_Buffer buffer;
+    int running;
+} Render_Thread;
+
+static void triple_buffer_init(Triple_Buffer *buffer) {
+    buffer->back = 0;
+    buffer->middle = 1;
+    buffer->front = 2;
+
+    pthread_mutex_init(&buffer->lock, 0);
+    pthread_cond_init(&buffer->published, 0);
+}
+
+static Frame_Snapshot *triple_buffer_back(Triple_Buffer *buffer) {
+    return &buffer->slots[buffer->back];
+}
+
+static void triple_buffer_publish(Triple_Buffer *buffer) {
+    int previous = __atomic_exchange_n(&buffer->middle, buffer->back | TRIPLE_NEW, __ATOMIC_ACQ_REL);
+    buffer->back = previous & TRIPLE_SLOT;
+
+    pthread_mutex_lock(&buffer->lock);
+    pthread_cond_signal(&buffer->published);
+    pthread_mutex_unlock(&buffer->lock);
+}
+
+// Blocks the consumer until a snapshot is published or *running is cleared.
+// The flag is rechecked under the lock, so a publish or triple_buffer_wake
+// that lands between the check and the wait is not lost.
+static void triple_buffer_wait(Triple_Buffer *buffer, int *running) {
+    pthread_mutex_lock(&buffer->lock);
+
+    while (!(__atomic_load_n(&buffer->middle, __ATOMIC_ACQUIRE) & TRIPLE_NEW) &&
+           __atomic_load_n(running, __ATOMIC_ACQUIRE))
+        pthread_cond_wait(&buffer->published, &buffer->lock);
+
+    pthread_mutex_unlock(&buffer->lock);
+}
+
+static void triple_buffer_wake(Triple_Buffer *buffer) {
+    pthread_mutex_lock(&buffer->lock);
+    pthread_cond_broadcast(&buffer->published);
+    pthread_mutex_unlock(&buffer->lock);
+}
+
+static int triple_buffer_consume(Triple_Buffer *buffer) {
+    if (!(__atomic_load_n(&buffer->middle, __ATOMIC_ACQUIRE) & TRIPLE_NEW))
+        return false;
+
+    int previous = __atomic_exchange_n(&buffer->middle, buffer->front, __ATOMIC_ACQ_REL);
+    buffer->front = previous & TRIPLE_SLOT;
+    return true;
+}
+
+static Frame_Snapshot *triple_buffer_front(Triple_Buffer *buffer) {
+    return &buffer->slots[buffer->front];
+}
+
+static void frame_stats_add(Frame_Stats *stats, double seconds) {
+    double ms = 1000.0 * seconds;
+
+    stats->count++;
+    stats->total += ms;
+    stats->total2 += ms * ms;
+    if (ms > stats->max)
+        stats->max = ms;
+}
+
+static void frame_stats_report(Frame_Stats *stats, const char *label) {
+    if (stats->count) {
+        double mean = stats->total / stats->count;
+        double sd = sqrt(fmax(stats->total2 / stats->count - mean * mean, 0.0));
+        fprintf(stdout, "%s: %d frames, frame time mean %fms, sd %fms, max %fms\n",
+                label, stats->count, mean, sd, stats->max);
+    }
+
+    *stats = {};
+}
+
+#endif
@@ -0,0 +1,17 @@
+#if !defined(HEADER_TIMER_CPP)
+#define HEADER_TIMER_CPP
+
+static double get_clock(void) {
+    struct timespec t;
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+// Seconds since the first call. CLOCK_MONOTONIC counts from boot, so the raw
+// value is large enough to lose sub-millisecond precision if it is narrowed.
+static double get_time(void) {
+    static double base = get_clock();
+    return get_clock() - base;
+}
+
+#endif
@@ -193,4 +193,34 @@ static M4x4 shear(Transform_Method method, char axis, float shear) {
     return result;
 }
 
+static M4x4 get_op_transform(Transform_Method method, Transform_Op *op) {
+    glm::vec3 a = { op->f[0], op->f[1], op->f[2] };
+    glm::vec3 b = { op->f[3], op->f[4], op->f[5] };
+    M4x4 result = m4x4_identity();
+
+    if (op->type == TRANSLATION)
+        result = translate(method, a);
+    else if (op->type == ROTATION)
+        result = rotation(method, a, b, op->f[6]);
+    else if (op->type == SCALING)
+        result = scale(method, a, b);
+    else if (op->type == REFLECTION)
+        result = reflection(method, { op->f[0], op->f[1], op->f[2], op->f[3] });
+    else if (op->type == SHEARING)
+        result = shear(method, op->axis, op->f[0]);
+
+    return result;
+}
+
+static M4x4 compose_ops(Transform_Method method, Transform_Op *ops, unsigned long long count) {
+    PROFILE_SCOPE("compose_ops");
+
+    M4x4 result = m4x4_identity();
+
+    for (unsigned long long i = 0; i < count; i++)
+        result = get_op_transform(method, &ops[i]) * result;
+
+    return result;
+}
+
 #endif
@@ -0,0 +1,205 @@
+#if !defined(HEADER_WELD_CPP)
+#define HEADER_WELD_CPP
+
+#define WELD_BATCH    4096
+#define WELD_CELL_MAX 1073741824.0f
+
+typedef struct {
+    unsigned long long key;
+    int index;
+} Weld_Cell;
+
+typedef struct {
+    unsigned int v[3];
+    int index;
+} Weld_Face;
+
+typedef struct {
+    Mesh *mesh;
+    float epsilon;
+    Weld_Cell *cells;
+    int *remap;
+    Weld_Face *faces;
+} Weld;
+
+static unsigned long long hash_cell(int x, int y, int z) {
+    unsigned long long h = (unsigned long long)(unsigned int)x * 0x9E3779B97F4A7C15ull;
+    h ^= (unsigned long long)(unsigned int)y * 0xC2B2AE3D27D4EB4Full + (h << 6) + (h >> 2);
+    h ^= (unsigned long long)(unsigned int)z * 0x165667B19E3779F9ull + (h << 6) + (h >> 2);
+    return h;
+}
+
+// Clamped before the conversion, since a coordinate far outside the epsilon
+// grid (or a non-finite one) would otherwise not fit in an int.
+static int get_cell_coord(float c, float epsilon) {
+    return (int)fmaxf(fminf(floorf(c / epsilon), WELD_CELL_MAX), -WELD_CELL_MAX);
+}
+
+static void get_cell(glm::vec3 v, float epsilon, int *x, int *y, int *z) {
+    *x = get_cell_coord(v.x, epsilon);
+    *y = get_cell_coord(v.y, epsilon);
+    *z = get_cell_coord(v.z, epsilon);
+}
+
+static int compare_weld_cell(const void *a, const void *b) {
+    const Weld_Cell *ca = (const Weld_Cell *)a;
+    const Weld_Cell *cb = (const Weld_Cell *)b;
+
+    if (ca->key != cb->key)
+        return ca->key < cb->key ? -1 : 1;
+    return ca->index - cb->index;
+}
+
+static int compare_weld_face(const void *a, const void *b) {
+    const Weld_Face *fa = (const Weld_Face *)a;
+    const Weld_Face *fb = (const Weld_Face *)b;
+
+    for (int i = 0; i < 3; i++) {
+        if (fa->v[i] != fb->v[i])
+            return fa->v[i] < fb->v[i] ? -1 : 1;
+    }
+    return fa->index - fb->index;
+}
+
+static int find_cell(Weld_Cell *cells, int count, unsigned long long key) {
+    int lo = 0, hi = count;
+
+    while (lo < hi) {
+        int mid = (lo + hi) / 2;
+        if (cells[mid].key < key) lo = mid + 1;
+        else                      hi = mid;
+    }
+
+    return lo;
+}
+
+static void hash_vertex_range(void *data, int begin, int end) {
+    Weld *weld = (Weld *)data;
+
+    for (int i = begin; i < end; i++) {
+        int x, y, z;
+        get_cell(weld->mesh->vertex[i].v, weld->epsilon, &x, &y, &z);
+        weld->cells[i].key = hash_cell(x, y, z);
+        weld->cells[i].index = i;
+    }
+}
+
+static void weld_vertex_range(void *data, int begin, int end) {
+    Weld *weld = (Weld *)data;
+    Vertex3 *vertex = weld->mesh->vertex;
+    int num_vertex = weld->mesh->num_vertex;
+    float epsilon2 = weld->epsilon * weld->epsilon;
+
+    for (int i = begin; i < end; i++) {
+        glm::vec3 v = vertex[i].v;
+        int best = i;
+        int x, y, z;
+        get_cell(v, weld->epsilon, &x, &y, &z);
+
+        for (int dz = -1; dz <= 1; dz++)
+        for (int dy = -1; dy <= 1; dy++)
+        for (int dx = -1; dx <= 1; dx++) {
+            unsigned long long key = hash_cell(x + dx, y + dy, z + dz);
+
+            for (int j = find_cell(weld->cells, num_vertex, key); j < num_vertex && weld->cells[j].key == key; j++) {
+                int other = weld->cells[j].index;
+                if (other >= best)
+                    break;
+
+                glm::vec3 d = vertex[other].v - v;
+                if (glm::dot(d, d) <= epsilon2)
+                    best = other;
+            }
+        }
+
+        weld->remap[i] = best;
+    }
+}
+
+static void remap_face_range(void *data, int begin, int end) {
+    Weld *weld = (Weld *)data;
+    Mesh *mesh = weld->mesh;
+    float min_area = weld->epsilon * weld->epsilon;
+
+    for (int i = begin; i < end; i++) {
+        Index3 *f = &mesh->index[i];
+        f->i1 = weld->remap[f->i1];
+        f->i2 = weld->remap[f->i2];
+        f->i3 = weld->remap[f->i3];
+
+        unsigned int a = f->i1, b = f->i2, c = f->i3, tmp;
+        if (a > b) { tmp = a; a = b; b = tmp; }
+        if (b > c) { tmp = b; b = c; c = tmp; }
+        if (a > b) { tmp = a; a = b; b = tmp; }
+
+        weld->faces[i].v[0] = a;
+        weld->faces[i].v[1] = b;
+        weld->faces[i].v[2] = c;
+        weld->faces[i].index = i;
+
+        glm::vec3 n = glm::cross(mesh->vertex[f->i2].v - mesh->vertex[f->i1].v,
+                                 mesh->vertex[f->i3].v - mesh->vertex[f->i1].v);
+
+        if (a == b || b == c || glm::length(n) <= min_area)
+            weld->faces[i].index = -1;
+    }
+}
+
+static void clean_mesh(Mesh *mesh, float epsilon) {
+    PROFILE_SCOPE("clean_mesh");
+
+    int num_vertex = mesh->num_vertex;
+    int num_faces = mesh->num_faces;
+
+    Weld weld = {};
+    weld.mesh = mesh;
+    weld.epsilon = epsilon;
+    weld.cells = (Weld_Cell *)malloc(num_vertex * sizeof(Weld_Cell));
+    weld.remap = (int *)malloc(num_vertex * sizeof(int));
+    weld.faces = (Weld_Face *)malloc(num_faces * sizeof(Weld_Face));
+
+    parallel_for(num_vertex, WELD_BATCH, hash_vertex_range, &weld);
+    qsort(weld.cells, num_vertex, sizeof(Weld_Cell), compare_weld_cell);
+    parallel_for(num_vertex, WELD_BATCH, weld_vertex_range, &weld);
+
+    int count = 0;
+    for (int i = 0; i < num_vertex; i++) {
+        if (weld.remap[i] == i) {
+            mesh->vertex[count] = mesh->vertex[i];
+            weld.remap[i] = count++;
+        } else {
+            weld.remap[i] = weld.remap[weld.remap[i]];
+        }
+    }
+    mesh->num_vertex = count;
+
+    parallel_for(num_faces, WELD_BATCH, remap_face_range, &weld);
+
+    unsigned char *keep = (unsigned char *)calloc(num_faces, 1);
+    qsort(weld.faces, num_faces, sizeof(Weld_Face), compare_weld_face);
+
+    for (int i = 0; i < num_faces; i++) {
+        Weld_Face *f = &weld.faces[i];
+        if (f->index < 0)
+            continue;
+        if (i > 0 && !memcmp(f->v, weld.faces[i - 1].v, sizeof(f->v)) && weld.faces[i - 1].index >= 0)
+            continue;
+        keep[f->index] = 1;
+    }
+
+    count = 0;
+    for (int i = 0; i < num_faces; i++) {
+        if (keep[i])
+            mesh->index[count++] = mesh->index[i];
+    }
+    mesh->num_faces = count;
+
+    free(keep);
+    free(weld.cells);
+    free(weld.remap);
+    free(weld.faces);
+
+    compute_normals(mesh);
+}
+
+#endif